@@ -2,13 +2,126 @@
 #include <assert.h>
 #include <exception>
 #include <cmath>
+#include <climits>
 #include <cstring>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace std;
 
-int time_to_second(string t);
+class Record;
+class TraceConfig;
+class ParsedTrace;
+class BankSimulator;
+class Branch;
+class InputReader;
+class Customer;
+class Event;
+
+int time_to_second(const char *t);
+bool is_time(string_view token);
 string second_to_time(int t);
+int format_time(int t,char *out);
+int parse_int(string_view token);
+string_view next_token(string_view &rest);
+string_view next_line(string_view &rest);
+bool parse_record(string_view line,Record &record);
+void bench_heap(int count);
+void bench_events(int count);
+int generate_trace(const TraceConfig &config,FILE *out);
+bool bench_run(const char *path,double &ms,long &peak_kb);
+void bench_suite(int records);
+int simulate(InputReader &reader,FILE *out,int reserve_hint,bool alloc_stats);
+int simulate_pipelined(InputReader &reader,FILE *out,int reserve_hint);
+int convert_trace(InputReader &reader,FILE *out);
+int replay_trace(const char *path,FILE *out,int reserve_hint);
+void write_completion(void *context,string_view name,int start_time,int end_time);
+int simulate_reference(InputReader &reader,FILE *out);
+bool diff_trace(const char *path,const char *label,const char *expected,double &fast_ms,double &reference_ms);
+int diff_engines(int argc,char *argv[]);
+void batch_task(void *context,int worker,int task);
+bool parse_range(const char *text,int &low,int &high);
+int sla_run(BankSimulator &bank,const ParsedTrace &trace,int m,int n,long long limit,long long &total_wait);
+void optimize_task(void *context,int worker,int task);
+int run_optimize(int argc,char *argv[]);
+int load_branches(InputReader &reader,Branch *&branches);
+void write_branch_completion(void *context,string_view name,int start_time,int end_time);
+void branch_task(void *context,int worker,int task);
+int run_branches(int argc,char *argv[]);
+int run_batch(int argc,char *argv[]);
+
+#ifdef PERF_STATS
+enum PerfPhase{PERF_RECORD,PERF_PARSE,PERF_DRAIN,PERF_ROUTE,PERF_DEPART,PERF_CHANGE,PERF_EMIT,PERF_OUTPUT,PERF_PHASES};
+enum PerfCounter{PERF_EVENTS_POPPED,PERF_SIFT_STEPS,PERF_TRIM_STEPS,PERF_LINE_ALLOCATIONS,PERF_MAX_LINE,PERF_TIMES_DECODED,PERF_COUNTERS};
+
+class PerfStats//PerfStats, time per phase, counters and a per-record latency histogram, one per thread, built with -DPERF_STATS
+{
+private:
+    static const int BUCKETS=40;//record latency in [2^i,2^(i+1)) ns
+    class ThreadStats;
+    long long phaseNs[PERF_PHASES];
+    long long phaseCalls[PERF_PHASES];
+    long long counters[PERF_COUNTERS];
+    long long latency[BUCKETS];
+    static mutex &finishedLock();
+    static PerfStats &finished();//threads that are gone, summed
+public:
+    PerfStats();
+    void addTime(PerfPhase phase,long long ns);
+    void count(PerfCounter counter,long long amount);
+    void keepMax(PerfCounter counter,long long value);
+    void merge(const PerfStats &other);
+    bool writeReport(const char *path)const;//JSON
+    static PerfStats &global();//this thread's, no locking
+    static PerfStats total();//finished threads and this one; join the workers first
+};
+
+class PerfStats::ThreadStats//the stats of one thread, handed to finished() when the thread ends
+{
+public:
+    PerfStats stats;
+    ~ThreadStats();
+};
+
+class PerfTimer//adds the time until it goes out of scope to a phase
+{
+private:
+    PerfPhase phase;
+    chrono::steady_clock::time_point start;
+public:
+    PerfTimer(PerfPhase phase);
+    ~PerfTimer();
+};
+
+#define PERF_CONCAT_(a,b) a##b
+#define PERF_CONCAT(a,b) PERF_CONCAT_(a,b)
+#define PERF_SCOPE(phase) PerfTimer PERF_CONCAT(perf_timer_,__LINE__)(phase)
+#define PERF_COUNT(counter,amount) PerfStats::global().count(counter,amount)
+#define PERF_MAX(counter,value) PerfStats::global().keepMax(counter,value)
+#else
+#define PERF_SCOPE(phase)
+#define PERF_COUNT(counter,amount)
+#define PERF_MAX(counter,value)
+#endif
 
 template <typename T>
 class Node//Node
@@ -19,134 +132,728 @@ private:
 public:
     Node();
     Node(const T&);
+    Node(T&&);
     Node(const T&,Node<T>*);
     void setItem(const T&);
+    void setItem(T&&);
     void setNext(Node<T>*);
-    T getItem()const;
+    const T &getItem()const;
     Node<T> *getNext()const;
 };
 
-template <typename T>
-class QueueInterface//QueueInterface
+template <typename Derived,typename T>
+class QueueInterface//QueueInterface, CRTP base, Derived has enqueue/dequeue/peekFront/get_size
 {
+protected:
+    const Derived &derived()const;
 public:
-    virtual bool isEmpty()const=0;
-    virtual bool enqueue(const T &newEntry)=0;
-    virtual bool dequeue()=0;
-    virtual T peekFront()const=0;
+    bool isEmpty()const;//chech if empty, from Derived::get_size
 };
 
-template <typename T>
-class PriorityQueueInterface//PriorityQueueInterface
+template <typename Derived,typename T>
+class PriorityQueueInterface//PriorityQueueInterface, CRTP base, Derived has isEmpty/add/remove/peekTop
+{
+protected:
+    const Derived &derived()const;
+public:
+    const T &peek()const;//see the item that leaves first
+};
+
+template <typename Derived,typename T>
+class HeapInterface//HeapInterface, CRTP base, Derived has getNumberOfNodes/peekTop/add/remove/clear
 {
+protected:
+    const Derived &derived()const;
 public:
-    virtual bool isEmpty()const=0;
-    virtual bool add(const T &newEntry)=0;
-    virtual bool remove()=0;
-    virtual T peek()const=0;
+    bool isEmpty()const;//check if empty, from Derived::getNumberOfNodes
 };
 
 template <typename T>
-class HeapInterface//HeapInterface
+class NodePool//NodePool, hands out Node<T> carved from big blocks and recycles them
 {
-    virtual bool isEmpty()const=0;
-    virtual int getNumberOfNodes()const=0;
-    virtual int getHeight()const=0;
-    virtual T peekTop()const=0;
-    virtual bool add(const T &newData)=0;
-    virtual bool remove()=0;
-    virtual void clear()=0;
+private:
+    static const int BLOCK_SIZE=1024;
+    Node<T> **blocks;
+    int blockCount;
+    int maxBlocks;
+    int carvedCount;//nodes constructed in the newest block
+    Node<T> *freeList;//released nodes, chained by next
+    long long allocationCount;//trips to the global heap
+    long long acquireCount;
+    int liveCount;
+    int peakCount;
+public:
+    NodePool();
+    ~NodePool();
+    Node<T> *acquire(const T &item);//a node holding item, next cleared
+    Node<T> *acquire(T &&item);
+    void release(Node<T> *nodePtr);//give the node back for reuse
+    long long getAllocationCount()const;
+    long long getAcquireCount()const;
+    int getPeakCount()const;//most nodes out at the same time
+    static NodePool<T> &shared();//pool used by queues that are not given one
 };
 
 template <typename T>
-class LinkedQueue:public QueueInterface<T>//LinkedQueue
+class LinkedQueue:public QueueInterface<LinkedQueue<T>,T>//LinkedQueue
 {
 private:
     Node<T> *backPtr;
     Node<T> *frontPtr;
     int size;
+    NodePool<T> *pool;
 public:
-    LinkedQueue();
+    LinkedQueue(NodePool<T> *pool=nullptr);
     LinkedQueue(const LinkedQueue &aQueue);
     ~LinkedQueue();
-    bool isEmpty()const;//chech if empty
     bool enqueue(const T &newEntry);//put item into queue
+    bool enqueue(T &&newEntry);
+    template <typename... Args>
+    bool emplace(Args&&... args);//build the item in place at the back
+    bool dequeue();//pop out an item
+    const T &peekFront()const;//see the item in the front
+    int get_size()const;//get the size of queue
+};
+
+template <typename T>
+class ArrayQueue:public QueueInterface<ArrayQueue<T>,T>//ArrayQueue, growable ring buffer, erased items leave tombstones
+{
+private:
+    static const int DEFAULT_CAPACITY=8;
+    T *items;
+    bool *erased;
+    long long frontHandle;//handle of the first slot in use
+    long long backHandle;//handle the next enqueue gets
+    int maxItems;//always a power of two
+    int size;//items not erased
+    long long allocationCount;
+    int getIndex(long long handle)const;
+    void grow();
+    void trim();//drop tombstones at both ends
+public:
+    ArrayQueue();
+    ArrayQueue(const ArrayQueue &aQueue);
+    ~ArrayQueue();
+    bool enqueue(const T &newEntry);//put item into queue
+    bool enqueue(T &&newEntry);
+    template <typename... Args>
+    bool emplace(Args&&... args);//build the item in place at the back
     bool dequeue();//pop out an item
-    T peekFront()const;//see the item in the front
+    const T &peekFront()const;//see the item in the front
     int get_size()const;//get the size of queue
+    long long getFrontHandle()const;//handle of the item in the front
+    long long getBackHandle()const;//handle of the item enqueue just added
+    bool contains(long long handle)const;//the handle names an item still in the queue
+    const T &getItem(long long handle)const;
+    bool erase(long long handle);//take an item out of the middle of the queue
+    T extract(long long handle);//erase and hand the item back
+    void clear();//drop every item, keep the buffer
+    long long getAllocationCount()const;//trips to the global heap
+};
+
+class TournamentTree//TournamentTree, which slot holds the smallest value, lowest index on ties
+{
+private:
+    int *values;
+    int *winner;//winner[base+i]==i for the leaves, -1 for padding
+    int leafCount;
+    int base;//leafCount rounded up to a power of two
+    int capacity;//base the arrays were made for
+    int play(int a,int b)const;
+public:
+    TournamentTree(int count);//all values start at 0
+    ~TournamentTree();
+    void reset(int count);//count slots, all 0, the arrays are kept if big enough
+    void update(int index,int value);//O(log count)
+    int getWinner()const;//-1 if there are no slots
+    int getValue(int index)const;
+};
+
+template <typename K,typename V>
+class HashTable//HashTable
+{
+private:
+    static const int DEFAULT_CAPACITY=16;
+    K *keys;
+    V *values;
+    bool *used;
+    int itemCount;
+    int maxItems;
+    int getHomeIndex(const K &key)const;
+    int getIndex(const K &key)const;//slot holding key, -1 if absent
+    void rehash(int newCapacity);
+public:
+    HashTable();
+    ~HashTable();
+    bool isEmpty()const;
+    int getSize()const;
+    bool add(const K &key,const V &value);//insert, or overwrite if key exists
+    V *find(const K &key)const;//nullptr if key is absent
+    void clear();
+};
+
+class NameTable//NameTable, a small id for every distinct name, the text kept in one arena
+{
+private:
+    static const int CHUNK_SIZE=1<<16;
+    HashTable<string_view,int> ids;//keys point into the arena
+    char **chunks;//arena; chunks never move, so views into them stay valid
+    int chunkCount;
+    int maxChunks;
+    int chunkUsed;//bytes taken in the newest chunk
+    string_view *names;//id -> text
+    int nameCount;
+    int maxNames;
+    const char *store(string_view name);//copy the text into the arena
+public:
+    NameTable();
+    ~NameTable();
+    int intern(string_view name);//id of name, new if never seen
+    int find(string_view name)const;//-1 if never seen
+    string_view getName(int id)const;
+    int getSize()const;
+    void clear();//forget every name, keep the first chunk and the tables
 };
 
 template <typename T>
-class ArrayMaxHeap:public HeapInterface<T>//ArrayMaxHeap
+class HeapSlot//an item of ArrayMaxHeap and the order it was added in
+{
+public:
+    T item;
+    unsigned long long order;
+};
+
+template <typename S>
+class DynamicStorage//storage policy of ArrayMaxHeap, raw slots from the global heap, any capacity
+{
+private:
+    S *slots;
+    int capacity;
+public:
+    static const bool RESIZABLE=true;
+    DynamicStorage();
+    DynamicStorage(const DynamicStorage&)=delete;
+    DynamicStorage &operator=(const DynamicStorage&)=delete;
+    ~DynamicStorage();
+    S *data()const;
+    int getCapacity()const;
+    bool reallocate(int newCapacity,int count);//move the first count slots into storage of another size, false if they do not fit
+};
+
+template <int CAPACITY>
+class FixedStorage//storage policy of ArrayMaxHeap, CAPACITY slots inside the heap itself, never allocates
+{
+public:
+    template <typename S>
+    class Of
+    {
+    private:
+        alignas(S) unsigned char buffer[sizeof(S)*CAPACITY];
+    public:
+        static const bool RESIZABLE=false;
+        S *data();
+        int getCapacity()const;
+        bool reallocate(int newCapacity,int count);//nothing moves, false unless count and newCapacity fit
+    };
+};
+
+class EventBefore//order of the event list, earlier left_time first
+{
+public:
+    constexpr bool operator()(const Event &a,const Event &b)const;
+};
+
+class CustomerBefore//print order, end_time then arrive_time
+{
+public:
+    constexpr bool operator()(const Customer &a,const Customer &b)const;
+};
+
+class EventTime//key of the event list, the second the customer leaves
+{
+public:
+    constexpr int operator()(const Event &ev)const;
+};
+
+template <typename T,typename COMPARE=less<T>,int ARITY=2,template <typename> class STORAGE=DynamicStorage>
+class ArrayMaxHeap:public HeapInterface<ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>,T>//ArrayMaxHeap, ARITY children per node, COMPARE(a,b) when a leaves first
 {
 private:
     static const int ROOT_INDEX=0;
-    static const int DEFAULT_CAPACITY=210000;
-    T *Items;
+    static const int DEFAULT_CAPACITY=16;
+    STORAGE<HeapSlot<T>> storage;
+    HeapSlot<T> *Items;//slots of storage, only the first itemCount are constructed
     int itemCount;
     int maxItems;
-    int getLeftChildIndex(const int nodeIndex)const;//2n+1
-    int getRightChildIndex(const int nodeIndex)const;//2n+2
+    int minItems;//never shrink below this, set by reserve()
+    unsigned long long addCount;
+    int getFirstChildIndex(const int nodeIndex)const;//ARITY*n+1
     int getParentIndex(const int nodeIndex)const;
     bool isLeaf(int nodeIndex)const;//check the node is leaf
+    bool isBefore(const HeapSlot<T> &a,const HeapSlot<T> &b)const;//a leaves the heap before b
+    int getBestChildIndex(int nodeIndex)const;//child that leaves first
+    void siftUp(int holeIndex,HeapSlot<T> &slot);//move slot up from the hole
     void heapRebuild(int subTreeRootIndex);//rebuild the heap
     void heapCreate();
+    bool reallocate(int newCapacity);//move the items into storage of another size, false if it can not
 public:
     ArrayMaxHeap();
-    ArrayMaxHeap(const T someArray[],const int arraySize);
-    virtual ~ArrayMaxHeap();
-    bool isEmpty()const;//check if empty
+    ArrayMaxHeap(const T someArray[],const int arraySize);//items past a fixed capacity are left out
+    ~ArrayMaxHeap();
     int getNumberOfNodes()const;//get number of nodes
     int getHeight()const;//the height
-    T peekTop()const;//see the item on the top
-    bool add(const T &newData);//add new item
+    const T &peekTop()const;//see the item on the top
+    bool add(const T &newData);//add new item, false if fixed storage is full
+    bool add(T &&newData);
+    template <typename... Args>
+    bool emplace(Args&&... args);//build the item in place
+    T pop();//move the top item out and remove it
     bool remove();//remove the top item
     void clear();//clear all item
+    void reserve(int capacity);//make room for capacity items up front
 };
 
-template <typename T>
-class Heap_PriorityQueue:public PriorityQueueInterface<T>,private ArrayMaxHeap<T>//Heap_PriorityQueue
+template <typename T,typename COMPARE=less<T>,int ARITY=2,template <typename> class STORAGE=DynamicStorage>
+class Heap_PriorityQueue:public ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>,public PriorityQueueInterface<Heap_PriorityQueue<T,COMPARE,ARITY,STORAGE>,T>//Heap_PriorityQueue
 {
 public:
     Heap_PriorityQueue();
+};
+
+template <typename T,typename KEY,int BITS=12>
+class TimingWheel:public PriorityQueueInterface<TimingWheel<T,KEY,BITS>,T>//TimingWheel, one FIFO slot per second of a 2^BITS second window
+{                                                                   //keys never go below the last one popped
+private:
+    static const int SLOT_COUNT=1<<BITS;
+    static const int MASK=SLOT_COUNT-1;
+    static_assert(BITS>=6,"the occupied bitmap needs whole 64-slot words");
+    class KeyBefore
+    {
+    public:
+        bool operator()(const T &a,const T &b)const;
+    };
+    class WheelNode
+    {
+    public:
+        T item;
+        int next;//index in nodes, -1 ends the slot
+    };
+    vector<WheelNode> nodes;
+    int freeNode;//chain of unused nodes, -1 if none
+    int head[SLOT_COUNT];
+    int tail[SLOT_COUNT];
+    unsigned long long occupied[SLOT_COUNT/64];//bit per slot that has items, skips empty seconds 64 at a time
+    int base;//first second of the window, never above the last key popped
+    mutable int cursor;//no slot before this one holds an item
+    int wheelCount;//items in the slots
+    Heap_PriorityQueue<T,KeyBefore,4> overflow;//keys at or past base+SLOT_COUNT, stable
+    int findFirst()const;//index of the first node, wheel must not be empty
+    void advance(int key);//move the window up to key and pull in what now fits
+    void push(int key,T &&item);//append to the slot of key
+public:
+    TimingWheel();
     bool isEmpty()const;
+    int get_size()const;
+    const T &peekTop()const;
     bool add(const T &newEntry);
+    bool add(T &&newEntry);
+    template <typename... Args>
+    bool emplace(Args&&... args);
     bool remove();
-    T peek()const throw(runtime_error);
+    T pop();//move the front item out and remove it
+    void clear();//empty the wheel, keep the node pool
+    void reserve(int capacity);
 };
 
 class Customer//Customer
 {
 public:
-    string name;
+    int name;//id in the NameTable
     int arrive_time;
     int start_time;
     int end_time;
     int time_need;
     bool business;
     int wait;
-    Customer();
-    Customer(string name,int arrive_time,int time_need,bool business);
-    bool operator>(const Customer &c);
-    bool operator<(const Customer &c);
-    bool operator>=(const Customer &c);
-    bool operator<=(const Customer &c);
-    bool operator==(const Customer &c);
+    constexpr Customer();
+    constexpr Customer(int name,int arrive_time,int time_need,bool business);
+    constexpr bool operator>(const Customer &c)const;
+    constexpr bool operator<(const Customer &c)const;
+    bool operator>=(const Customer &c)const;
+    bool operator<=(const Customer &c)const;
+    bool operator==(const Customer &c)const;
 };
 
 class Event
 {
 public:
-    string name;
+    int customer;//index in the CustomerTable
     int start_time;
     int left_time;
-    Event();
-    Event(string name,int start_time,int left_time);
-    bool operator>(const Event &ev);
-    bool operator<(const Event &ev);
-    bool operator>=(const Event &ev);
-    bool operator<=(const Event &ev);
-    bool operator==(const Event &ev);
+    bool business;//kind of the counter serving the customer
+    int counter;//index into business_line or normal_line
+    constexpr Event();
+    constexpr Event(int customer,int start_time,int left_time,bool business,int counter);
+    constexpr bool operator>(const Event &ev)const;
+    constexpr bool operator<(const Event &ev)const;
+    bool operator>=(const Event &ev)const;
+    bool operator<=(const Event &ev)const;
+    bool operator==(const Event &ev)const;
+};
+
+#ifdef USE_TIMING_WHEEL
+typedef TimingWheel<Event,EventTime> EventList;//build with -DUSE_TIMING_WHEEL for the calendar queue
+#else
+typedef Heap_PriorityQueue<Event,EventBefore,4> EventList;
+#endif
+
+class Locator//where a waiting customer is
+{
+public:
+    int line;//same numbering as the C record: business lines first, then normal lines
+    long long handle;//position in that line
+    Locator();
+    Locator(int line,long long handle);
+};
+
+class CustomerTable//CustomerTable, the fields of Customer as columns, a customer is a 32-bit index
+{
+private:
+    vector<int> nextFree;//chain of released indices
+    int freeList;//-1 if none
+    int liveCount;
+public:
+    vector<int> name;//id in the NameTable
+    vector<int> arrive_time;
+    vector<int> start_time;
+    vector<int> end_time;
+    vector<int> time_need;
+    vector<int> wait;
+    vector<char> business;
+    vector<Locator> place;//line and handle while in a line, line -1 otherwise
+    vector<int> nextSame;//next customer in a line with the same name, -1 ends
+    vector<int> prevSame;
+    CustomerTable();
+    int add(int name,int arrive_time,int time_need,bool business);//index of the new customer, released ones are reused
+    void release(int index);//the customer is gone, its index may be handed out again
+    int getSize()const;//customers not released
+    void reserve(int capacity);
+    void clear();//release everyone, keep the columns' capacity
+};
+
+class Record//one input line, name points into the InputReader buffer
+{
+public:
+    int time;
+    char code;//'A', 'D' or 'C'
+    string_view name;
+    int name_id;//id given by whoever interned name, -1 if nobody did
+    bool business;
+    int value;//time needed for A, target line for C
+    Record();
+};
+
+class OutputWriter//OutputWriter, formats into one big buffer and writes it out in large chunks
+{
+private:
+    static const int BUFFER_SIZE=1<<16;
+    char *buffer;
+    int used;
+    FILE *file;
+    void makeRoom(int bytes);//flush if bytes do not fit
+public:
+    OutputWriter(FILE *file=stdout);
+    ~OutputWriter();//flushes
+    void write(const char *text,int length);
+    void write(const string &text);
+    void write(char c);
+    void writeTime(int t);//HH:MM:SS
+    void writeInt(long long value);
+    void writeDouble(double value);//same text as cout<<value
+    void flush();
+};
+
+typedef void (*CompletionCallback)(void *context,string_view name,int start_time,int end_time);//one served customer, name is valid during the call
+
+class CompletionEmitter//CompletionEmitter, reports served customers as soon as nothing can finish before them
+{
+private:
+    class SortItem
+    {
+    public:
+        unsigned long long key;//end_time then arrive_time as one unsigned number
+        int customer;
+    };
+    static const int SMALL_BATCH=64;//insertion sort below this
+    vector<int> pending;//customers served but not printed yet, in the order they ended
+    vector<SortItem> batch;//the part of pending being printed, with its keys
+    vector<SortItem> scratch;//other buffer of the radix sort
+    int first;//pending[first..] are not printed yet
+    CompletionCallback callback;//nullptr drops them
+    void *context;
+    const vector<string_view> *names;//name id -> text
+    CustomerTable *customers;
+    void sortBatch(int last);//order pending[first..last) by key, equal keys keep their order
+    void emitBatch(int last);//sort and report pending[first..last), then release them
+public:
+    CompletionEmitter(const vector<string_view> *names,CustomerTable *customers);
+    void setCallback(CompletionCallback callback,void *context);
+    void add(int customer);
+    void reserve(int capacity);
+    void reset();//forget everyone pending, keep the buffers
+    void emitBefore(int watermark);//print everyone who ended before watermark
+    void emitAll();
+};
+
+class InputReader//InputReader, hands out whole lines of an mmapped file or of stdin read in big blocks
+{
+private:
+    static const size_t BLOCK_SIZE=1<<20;
+    const char *data;
+    size_t length;
+    size_t position;
+    char *buffer;//stdin only
+    size_t bufferSize;
+    bool mapped;
+    bool atEnd;//nothing more to read from stdin
+    bool refill();//keep the unread tail, append the next block
+public:
+    InputReader();
+    ~InputReader();
+    bool open(const char *path);//map a file instead of reading stdin
+    bool readLine(string_view &line);//valid until the next call
+};
+
+class TraceConfig//TraceConfig, knobs of generate_trace, set from key=value words
+{
+public:
+    int records;
+    int m;//normal counters
+    int n;//business counters
+    unsigned int seed;
+    double rate;//arrivals per second on average
+    double service;//mean seconds at the counter
+    char dist;//service time: 'e'xponential, 'u'niform in [0,2*service] or 'f'ixed
+    double business;//share of business customers
+    double depart;//share of records that are D
+    double change;//share of records that are C
+    double noise;//share of D and C that ignore the rules, the simulator must skip them
+    double reuse;//share of arrivals named like a recent customer, who may still be in a line
+    double pairs;//share of arrivals named like the last one of the line they join
+    double ties;//share of records at the same second as the one before
+    int start;//second of the first record
+    TraceConfig();
+    bool set(const char *arg);//false unless arg is key=value with a known key
+};
+
+class BankSimulator//BankSimulator, the whole bank fed one record at a time, reset() keeps every buffer for the next run
+{
+private:
+    int m;//normal counters
+    int n;//business counters
+    ArrayQueue<int> *lines;//customer indices, business lines first, then normal lines, like Locator
+    int lineCapacity;
+    vector<char> busy;//someone of that line is at the counter
+    TournamentTree normal_shortest;//line lengths, for routing arrivals
+    TournamentTree business_shortest;
+    EventList event_list;
+    NameTable names;//names of records that come without an id
+    vector<string_view> nameText;//name id -> text, from names or from the records
+    CustomerTable customers;//everyone not reported yet, lines and events hold indices
+    CompletionEmitter customer_list;//served customers, reported in end/arrive order
+    vector<int> waiting;//name id -> a customer of that name in a line, -1 if none; the others follow nextSame
+    vector<int> matches;//filled by findWaiting
+    long long total_time;
+    int customer_num;
+    int first_time;//time of the first record, -1 before it
+    int last_time;//latest end_time served
+    vector<long long> busy_time;//seconds each line's counter spent serving
+    int internName(const Record &record);//id of the name of an arrival
+    int findName(const Record &record)const;//-1 if no arrival had that name
+    void updateLength(int line);
+    void link(int c);//c joined a line, make it findable by name
+    void unlink(int c);//c left the lines
+    int findWaiting(int name);//line a scan stops at for name, -1 if none; matches gets who is behind its counter, front first
+    void serve(const Event &ev);//the customer of ev is done, the next one steps up
+    void arrive(const Record &record);
+    void depart(const Record &record);
+    void changeLine(const Record &record);
+public:
+    BankSimulator();
+    ~BankSimulator();
+    void configure(int m,int n);//m normal and n business counters, the bank starts empty
+    void reserve(int customers);
+    void setCompletionCallback(CompletionCallback callback,void *context);
+    void feed(const Record &record);//time never goes back; a run gives name_id on all records or on none
+    void advance_to(int time);//serve and report everyone who ends before time
+    void finish();//serve and report everyone left
+    void reset();//empty bank of the same size
+    long long getTotalWait()const;
+    int getCustomerCount()const;//served or left
+    int getMakespan()const;//first record to the last customer served
+    long long getBusyTime(int line)const;//line numbered like Locator
+    long long getAllocationCount()const;//line buffers taken from the global heap
+};
+
+class ParsedTrace//ParsedTrace, a whole input parsed once, shared read-only by every simulation of it
+{
+public:
+    int m;
+    int n;
+    vector<Record> records;//names point into the arena of names
+    NameTable names;
+    ParsedTrace();
+    bool load(InputReader &reader);//false if there is no header
+    void add(Record record);//keeps its own copy of the name
+};
+
+typedef void (*TaskFunction)(void *context,int worker,int task);
+
+class TaskPool//TaskPool, numbered tasks on worker threads, an idle worker steals from the others
+{
+private:
+    class WorkerQueue
+    {
+    public:
+        mutex lock;
+        deque<int> tasks;//the owner takes from the back, thieves from the front
+    };
+    WorkerQueue *queues;
+    int workerCount;
+    bool take(int worker,int &task);
+    void work(int worker,TaskFunction function,void *context);
+public:
+    TaskPool(int workers);
+    ~TaskPool();
+    int getWorkerCount()const;
+    void run(int taskCount,TaskFunction function,void *context);//function(context,worker,task) for every task, the caller is worker 0
+};
+
+class BatchResult//one row of the --batch table
+{
+public:
+    int m;
+    int n;
+    int customers;
+    long long total_wait;
+    int makespan;
+    double load_min;//share of the makespan a counter was serving
+    double load_avg;
+    double load_max;
+    BatchResult();
+};
+
+class BatchJob//what batch_task needs, shared by the workers
+{
+public:
+    const ParsedTrace *trace;
+    BankSimulator *simulators;//one per worker, its buffers stay warm from task to task
+    BatchResult *results;
+};
+
+class OptimizeJob//what optimize_task needs, the bisection of every n shares what the others found
+{
+public:
+    static const int NONE=INT_MAX;//no m in range meets the target
+    const ParsedTrace *trace;
+    BankSimulator *simulators;//one per worker
+    int m_low,m_high,n_low;
+    long long limit;//fail once 2*total_time reaches this
+    mutex lock;//guards best
+    vector<int> best;//smallest m meeting the target for n_low+i, -1 while searching
+    vector<long long> best_wait;//total wait at best, -1 if it was taken from another n
+    long long evaluations;
+    long long aborted;//stopped before the end of the trace
+};
+
+class Branch//Branch, one bank of a --branches trace, simulated on its own and printed in header order
+{
+public:
+    int id;
+    ParsedTrace trace;//m and n of the branch and its records
+    OutputWriter *writer;//while it runs
+    char *output;//all it printed, from open_memstream
+    size_t outputSize;
+    Branch();
+    ~Branch();
+};
+
+class BranchJob//what branch_task needs, shared by the workers
+{
+public:
+    Branch *branches;
+    BankSimulator *simulators;//one per worker
+};
+
+template <typename T>
+class SpscRing//SpscRing, lock-free ring from one producer thread to one consumer thread, items move in batches
+{
+private:
+    T *items;
+    size_t capacity;//a power of two
+    alignas(64) atomic<size_t> head;//next item the consumer takes
+    alignas(64) atomic<size_t> tail;//next slot the producer fills
+    alignas(64) atomic<bool> closed;
+public:
+    SpscRing(int capacity);
+    ~SpscRing();
+    void push(const T *batch,int count);//waits while the ring is full, that is the backpressure
+    int pop(T *batch,int maxCount);//waits while it is empty, 0 once closed and drained
+    void close();//the producer is done
+};
+
+class BinaryHeader//BinaryHeader, start of a --convert file; then nameCount name ends, the name bytes, padding to 16 and the records
+{
+public:
+    static const uint32_t VERSION=1;
+    char magic[4];//"BKTR"
+    uint32_t version;
+    int32_t m;
+    int32_t n;
+    uint32_t recordCount;
+    uint32_t nameCount;
+    uint64_t nameBytes;//all names back to back, name i ends at the i-th offset
+};
+
+class BinaryRecord//one record of a --convert file, fixed width so replay needs no parsing
+{
+public:
+    uint32_t time;//seconds
+    uint8_t code;//'A', 'D' or 'C'
+    uint8_t business;
+    uint16_t reserved;
+    uint32_t name;//index in the name table
+    int32_t value;//time needed for A, target line for C
+};
+
+class Completion//a served customer on its way to the writer thread
+{
+public:
+    string_view name;//points into the simulator's name arena
+    int start_time;
+    int end_time;
+};
+
+class Pipeline//Pipeline, parser, simulator and writer threads joined by SpscRings
+{
+private:
+    static const int BATCH=256;//items per hand over
+    static const int RING_SIZE=1<<14;
+    InputReader *reader;
+    NameTable names;//parser side, records sent on point into its arena
+    SpscRing<Record> records;
+    SpscRing<Completion> completions;
+    BankSimulator bank;
+    Completion pending[BATCH];//served, not handed to the writer yet
+    int pendingCount;
+    void parse();//parser thread
+    void simulate();//simulator thread
+    static void complete(void *context,string_view name,int start_time,int end_time);
+public:
+    Pipeline(InputReader *reader,int m,int n,int reserve);
+    void run(OutputWriter &writer);//the calling thread is the writer
+    long long getTotalWait()const;
+    int getCustomerCount()const;
 };
 //NODE====================================================================================================
 
@@ -155,6 +862,8 @@ Node<T>::Node():next(nullptr){}
 template <typename T>
 Node<T>::Node(const T &n):item(n),next(nullptr){}
 template <typename T>
+Node<T>::Node(T &&n):item(move(n)),next(nullptr){}
+template <typename T>
 Node<T>::Node(const T &n,Node<T> *next):item(n),next(next){}
 template <typename T>
 void Node<T>::setItem(const T &it)
@@ -162,6 +871,12 @@ void Node<T>::setItem(const T &it)
     this->item=it;
 }
 
+template <typename T>
+void Node<T>::setItem(T &&it)
+{
+    this->item=move(it);
+}
+
 template <typename T>
 void Node<T>::setNext(Node<T> *next)
 {
@@ -169,7 +884,7 @@ void Node<T>::setNext(Node<T> *next)
 }
 
 template <typename T>
-T Node<T>::getItem()const
+const T& Node<T>::getItem()const
 {
     return item;
 }
@@ -182,12 +897,144 @@ Node<T>* Node<T>::getNext()const
 
 //NODE====================================================================================================
 
+//Interfaces==============================================================================================
+
+template <typename Derived,typename T>
+const Derived& QueueInterface<Derived,T>::derived()const
+{
+    return *static_cast<const Derived*>(this);
+}
+template <typename Derived,typename T>
+bool QueueInterface<Derived,T>::isEmpty()const
+{
+    return derived().get_size()==0;
+}
+
+template <typename Derived,typename T>
+const Derived& PriorityQueueInterface<Derived,T>::derived()const
+{
+    return *static_cast<const Derived*>(this);
+}
+template <typename Derived,typename T>
+const T& PriorityQueueInterface<Derived,T>::peek()const
+{
+    assert(!derived().isEmpty());
+    return derived().peekTop();
+}
+
+template <typename Derived,typename T>
+const Derived& HeapInterface<Derived,T>::derived()const
+{
+    return *static_cast<const Derived*>(this);
+}
+template <typename Derived,typename T>
+bool HeapInterface<Derived,T>::isEmpty()const
+{
+    return derived().getNumberOfNodes()==0;
+}
+
+//Interfaces==============================================================================================
+
+//NodePool================================================================================================
+
+template <typename T>
+NodePool<T>::NodePool():blocks(nullptr),blockCount(0),maxBlocks(0),carvedCount(BLOCK_SIZE),freeList(nullptr),
+    allocationCount(0),acquireCount(0),liveCount(0),peakCount(0){}
+template <typename T>
+NodePool<T>::~NodePool()
+{
+    for(int i=0;i<blockCount;i++)
+    {
+        int carved=(i==blockCount-1)?carvedCount:BLOCK_SIZE;
+        for(int j=0;j<carved;j++)
+            blocks[i][j].~Node<T>();
+        operator delete(blocks[i]);
+    }
+    delete[] blocks;
+}
+template <typename T>
+Node<T>* NodePool<T>::acquire(const T &item)
+{
+    return acquire(T(item));
+}
+template <typename T>
+Node<T>* NodePool<T>::acquire(T &&item)
+{
+    Node<T> *nodePtr;
+    if(freeList!=nullptr)
+    {
+        nodePtr=freeList;
+        freeList=freeList->getNext();
+        nodePtr->setItem(move(item));
+        nodePtr->setNext(nullptr);
+    }
+    else
+    {
+        if(carvedCount==BLOCK_SIZE)                             //newest block used up, get another
+        {
+            if(blockCount==maxBlocks)
+            {
+                Node<T> **oldBlocks=blocks;
+                maxBlocks=(maxBlocks==0)?16:2*maxBlocks;
+                blocks=new Node<T>*[maxBlocks];
+                for(int i=0;i<blockCount;i++)
+                    blocks[i]=oldBlocks[i];
+                delete[] oldBlocks;
+                allocationCount++;
+            }
+            blocks[blockCount++]=static_cast<Node<T>*>(operator new(sizeof(Node<T>)*BLOCK_SIZE));
+            carvedCount=0;
+            allocationCount++;
+        }
+        nodePtr=new(&blocks[blockCount-1][carvedCount++]) Node<T>(move(item));
+    }
+    acquireCount++;
+    liveCount++;
+    if(liveCount>peakCount)
+        peakCount=liveCount;
+    return nodePtr;
+}
+template <typename T>
+void NodePool<T>::release(Node<T> *nodePtr)
+{
+    nodePtr->setNext(freeList);                                 //the item stays until the node is reused
+    freeList=nodePtr;
+    liveCount--;
+}
+template <typename T>
+long long NodePool<T>::getAllocationCount()const
+{
+    return allocationCount;
+}
+template <typename T>
+long long NodePool<T>::getAcquireCount()const
+{
+    return acquireCount;
+}
+template <typename T>
+int NodePool<T>::getPeakCount()const
+{
+    return peakCount;
+}
+template <typename T>
+NodePool<T>& NodePool<T>::shared()
+{
+    static NodePool<T> pool;
+    return pool;
+}
+
+//NodePool================================================================================================
+
 //LinkedQueue=============================================================================================
 
 template <typename T>
-LinkedQueue<T>::LinkedQueue():frontPtr(nullptr),backPtr(nullptr),size(0){}
+LinkedQueue<T>::LinkedQueue(NodePool<T> *pool):backPtr(nullptr),frontPtr(nullptr),size(0),pool(pool)
+{
+    if(this->pool==nullptr)
+        this->pool=&NodePool<T>::shared();
+}
 template <typename T>
-LinkedQueue<T>::LinkedQueue(const LinkedQueue &aQueue)
+LinkedQueue<T>::LinkedQueue(const LinkedQueue &aQueue):pool(aQueue.pool)
 {
     Node<T> *origChainPtr=aQueue.frontPtr;
     if(origChainPtr==nullptr)
@@ -197,14 +1044,13 @@ LinkedQueue<T>::LinkedQueue(const LinkedQueue &aQueue)
     }
     else
     {
-        frontPtr=new Node<T>();
-        frontPtr->setItem(origChainPtr->getItem());
+        frontPtr=pool->acquire(origChainPtr->getItem());
         origChainPtr=origChainPtr->getNext();
         Node<T> *newChainPtr=frontPtr;
         while(origChainPtr!=nullptr)
         {
-            T nextItem=origChainPtr->getgetItem();
-            Node<T> *newNodePtr=new Node<T>(nextItem);
+            T nextItem=origChainPtr->getItem();
+            Node<T> *newNodePtr=pool->acquire(nextItem);
             newChainPtr->setNext(newNodePtr);
             newChainPtr=newChainPtr->getNext();
             origChainPtr=origChainPtr->getNext();
@@ -217,7 +1063,7 @@ LinkedQueue<T>::LinkedQueue(const LinkedQueue &aQueue)
 template <typename T>
 LinkedQueue<T>::~LinkedQueue()
 {
-    while(!isEmpty())
+    while(!this->isEmpty())
     {
         dequeue();
     }
@@ -225,15 +1071,21 @@ LinkedQueue<T>::~LinkedQueue()
     assert((backPtr==nullptr)&&(frontPtr==nullptr));
 }
 template <typename T>
-bool LinkedQueue<T>::isEmpty()const
+bool LinkedQueue<T>::enqueue(const T &newEntry)
 {
-    return backPtr==nullptr;
+    return enqueue(T(newEntry));
 }
 template <typename T>
-bool LinkedQueue<T>::enqueue(const T &newEntry)
+template <typename... Args>
+bool LinkedQueue<T>::emplace(Args&&... args)
 {
-    Node<T> *newNodePtr=new Node<T>(newEntry);
-    if(isEmpty())
+    return enqueue(T(forward<Args>(args)...));
+}
+template <typename T>
+bool LinkedQueue<T>::enqueue(T &&newEntry)
+{
+    Node<T> *newNodePtr=pool->acquire(move(newEntry));
+    if(this->isEmpty())
         frontPtr=newNodePtr;
     else
         backPtr->setNext(newNodePtr);
@@ -245,7 +1097,7 @@ template <typename T>
 bool LinkedQueue<T>::dequeue()
 {
     bool result=false;
-    if(!isEmpty())
+    if(!this->isEmpty())
     {
         Node<T> *nodeToDeletePtr=frontPtr;
         if(frontPtr==backPtr)
@@ -255,8 +1107,7 @@ bool LinkedQueue<T>::dequeue()
         }
         else
             frontPtr=frontPtr->getNext();
-        nodeToDeletePtr->setNext(nullptr);
-        delete nodeToDeletePtr;
+        pool->release(nodeToDeletePtr);
         nodeToDeletePtr=nullptr;
         result=true;
         size--;
@@ -264,9 +1115,9 @@ bool LinkedQueue<T>::dequeue()
     return result;
 }
 template <typename T>
-T LinkedQueue<T>::peekFront()const
+const T& LinkedQueue<T>::peekFront()const
 {
-    assert(!isEmpty());
+    assert(!this->isEmpty());
     return frontPtr->getItem();
 }
 template <typename T>
@@ -277,697 +1128,3535 @@ int LinkedQueue<T>::get_size()const
 
 //LinkedQueue=============================================================================================
 
-//ArrayMaxHeap============================================================================================
+//ArrayQueue==============================================================================================
 
 template <typename T>
-int ArrayMaxHeap<T>::getLeftChildIndex(const int nodeIndex)const
+int ArrayQueue<T>::getIndex(long long handle)const
 {
-    return (2*nodeIndex)+1;
+    return (int)(handle&(maxItems-1));
 }
 template <typename T>
-int ArrayMaxHeap<T>::getRightChildIndex(const int nodeIndex)const
+void ArrayQueue<T>::grow()
 {
-    return (2*nodeIndex)+2;
+    T *oldItems=items;
+    bool *oldErased=erased;
+    int oldMaxItems=maxItems;
+    maxItems=(maxItems==0)?DEFAULT_CAPACITY:2*maxItems;
+    items=new T[maxItems];
+    erased=new bool[maxItems];
+    for(long long handle=frontHandle;handle<backHandle;handle++)     //handles stay valid, only their slots move
+    {
+        items[getIndex(handle)]=move(oldItems[handle&(oldMaxItems-1)]);
+        erased[getIndex(handle)]=oldErased[handle&(oldMaxItems-1)];
+    }
+    delete[] oldItems;
+    delete[] oldErased;
+    allocationCount+=2;
 }
 template <typename T>
-int ArrayMaxHeap<T>::getParentIndex(const int nodeIndex) const
+void ArrayQueue<T>::trim()
 {
-    return (nodeIndex-1)/2;
+    while(frontHandle<backHandle&&erased[getIndex(frontHandle)])
+    {
+        PERF_COUNT(PERF_TRIM_STEPS,1);
+        frontHandle++;
+    }
+    while(frontHandle<backHandle&&erased[getIndex(backHandle-1)])
+    {
+        PERF_COUNT(PERF_TRIM_STEPS,1);
+        backHandle--;
+    }
 }
 template <typename T>
-bool ArrayMaxHeap<T>::isLeaf(int nodeIndex) const
-{
-    if (!(getLeftChildIndex(nodeIndex)<itemCount)&&!(getRightChildIndex(nodeIndex)<itemCount))
-        return true;
-    else
-        return false;
-}
+ArrayQueue<T>::ArrayQueue():items(nullptr),erased(nullptr),frontHandle(0),backHandle(0),maxItems(0),size(0),allocationCount(0){}
 template <typename T>
-void ArrayMaxHeap<T>::heapRebuild(int subTreeRootIndex)
+ArrayQueue<T>::ArrayQueue(const ArrayQueue &aQueue):frontHandle(aQueue.frontHandle),backHandle(aQueue.backHandle),
+    maxItems(aQueue.maxItems),size(aQueue.size),allocationCount(0)
 {
-    if (!isLeaf(subTreeRootIndex))
+    items=nullptr;
+    erased=nullptr;
+    if(maxItems>0)
     {
-        int largerChildIndex=2*subTreeRootIndex+1;
-
-        if(getRightChildIndex(subTreeRootIndex)!=0)
-        {
-            int rightChildIndex=largerChildIndex+1;
-            if (Items[rightChildIndex]<Items[largerChildIndex])
-                largerChildIndex=rightChildIndex;
-        }
-        if(Items[subTreeRootIndex]>Items[largerChildIndex])
+        items=new T[maxItems];
+        erased=new bool[maxItems];
+        for(int i=0;i<maxItems;i++)
         {
-            swap(Items[subTreeRootIndex],Items[largerChildIndex]);
-            heapRebuild(largerChildIndex);
+            items[i]=aQueue.items[i];
+            erased[i]=aQueue.erased[i];
         }
+        allocationCount+=2;
     }
 }
 template <typename T>
-void ArrayMaxHeap<T>::heapCreate()
+ArrayQueue<T>::~ArrayQueue()
 {
-    for (int index=itemCount/2;index>=0;index--)
-    {
-        heapRebuild(index);
-    }
+    delete[] items;
+    delete[] erased;
 }
 template <typename T>
-ArrayMaxHeap<T>::ArrayMaxHeap():itemCount(0),maxItems(DEFAULT_CAPACITY)
+bool ArrayQueue<T>::enqueue(const T &newEntry)
 {
-    Items=new T[maxItems];
+    return enqueue(T(newEntry));
 }
 template <typename T>
-ArrayMaxHeap<T>::ArrayMaxHeap(const T someArray[],const int arraySize):itemCount(arraySize),maxItems(2*arraySize)
+template <typename... Args>
+bool ArrayQueue<T>::emplace(Args&&... args)
 {
-    Items=new T[2*arraySize];
-    for (int i=0;i<itemCount;i++)
-        Items[i] = someArray[i];
-    heapCreate();
+    return enqueue(T(forward<Args>(args)...));
 }
 template <typename T>
-ArrayMaxHeap<T>::~ArrayMaxHeap()
+void ArrayQueue<T>::clear()
 {
-    delete[] Items;
+    frontHandle=0;
+    backHandle=0;
+    size=0;
 }
 template <typename T>
-bool ArrayMaxHeap<T>::isEmpty()const
+bool ArrayQueue<T>::enqueue(T &&newEntry)
 {
-    if(itemCount==0)
-        return true;
-    else
-        return false;
+    if(backHandle-frontHandle==maxItems)
+        grow();
+    items[getIndex(backHandle)]=move(newEntry);
+    erased[getIndex(backHandle)]=false;
+    backHandle++;
+    size++;
+    return true;
 }
 template <typename T>
-int ArrayMaxHeap<T>::getNumberOfNodes()const
+bool ArrayQueue<T>::dequeue()
 {
-    return itemCount+1;
+    if(this->isEmpty())
+        return false;
+    erased[getIndex(frontHandle)]=true;
+    size--;
+    trim();
+    return true;
 }
 template <typename T>
-int ArrayMaxHeap<T>::getHeight()const
+const T& ArrayQueue<T>::peekFront()const
 {
-    return ceil(log2(itemCount+1));
+    assert(!this->isEmpty());
+    return items[getIndex(frontHandle)];
 }
 template <typename T>
-T ArrayMaxHeap<T>::peekTop()const
+int ArrayQueue<T>::get_size()const
 {
-    assert(!isEmpty());
-    return Items[0];
+    return size;
 }
 template <typename T>
-bool ArrayMaxHeap<T>::add(const T& newData)
+long long ArrayQueue<T>::getFrontHandle()const
 {
-    if (itemCount==maxItems)
-        return false;
-    Items[itemCount]=newData;
-    int newDataIndex=itemCount;
-    bool inPlace=false;
-    while(newDataIndex>0&&!inPlace)
-    {
-        int parentIndex=(newDataIndex-1)/2;
-        if (Items[newDataIndex]>Items[parentIndex])
-            inPlace=true;
-        else
-        {
-            swap(Items[newDataIndex],Items[parentIndex]);
-            newDataIndex=parentIndex;
-        }
-    }
-    itemCount++;
-    return true;
+    return frontHandle;
 }
 template <typename T>
-bool ArrayMaxHeap<T>::remove()
+long long ArrayQueue<T>::getBackHandle()const
 {
-    if(isEmpty())
-        return false;
-    Items[0]=Items[itemCount-1];
-    itemCount--;
-    heapRebuild(0);
-    return true;
+    return backHandle-1;
 }
 template <typename T>
-void ArrayMaxHeap<T>::clear()
+bool ArrayQueue<T>::contains(long long handle)const
 {
-    itemCount=0;
+    return handle>=frontHandle&&handle<backHandle&&!erased[getIndex(handle)];
 }
-
-//ArrayMaxHeap============================================================================================
-
-//Heap_PriorityQueue======================================================================================
-
 template <typename T>
-Heap_PriorityQueue<T>::Heap_PriorityQueue():PriorityQueueInterface<T>(),ArrayMaxHeap<T>(){}
-
-template <typename T>
-bool Heap_PriorityQueue<T>::isEmpty()const
+const T& ArrayQueue<T>::getItem(long long handle)const
 {
-    return ArrayMaxHeap<T>::isEmpty();
+    assert(contains(handle));
+    return items[getIndex(handle)];
 }
 template <typename T>
-bool Heap_PriorityQueue<T>::add(const T &newEntry)
+bool ArrayQueue<T>::erase(long long handle)
 {
-    return ArrayMaxHeap<T>::add(newEntry);
+    if(!contains(handle))
+        return false;
+    erased[getIndex(handle)]=true;
+    size--;
+    trim();
+    return true;
 }
 template <typename T>
-bool Heap_PriorityQueue<T>::remove()
+T ArrayQueue<T>::extract(long long handle)
 {
-    return ArrayMaxHeap<T>::remove();
+    assert(contains(handle));
+    T item=move(items[getIndex(handle)]);
+    erase(handle);
+    return item;
 }
 template <typename T>
-T Heap_PriorityQueue<T>::peek()const throw(runtime_error)
+long long ArrayQueue<T>::getAllocationCount()const
+{
+    return allocationCount;
+}
+
+//ArrayQueue==============================================================================================
+
+//TournamentTree==========================================================================================
+
+int TournamentTree::play(int a,int b)const
+{
+    if(a<0)
+        return b;
+    if(b<0)
+        return a;
+    if(values[b]<values[a])                     //a always comes from the left, so a wins ties
+        return b;
+    return a;
+}
+
+TournamentTree::TournamentTree(int count):values(nullptr),winner(nullptr),capacity(0)
+{
+    reset(count);
+}
+
+void TournamentTree::reset(int count)
 {
-    try
+    leafCount=count;
+    base=1;
+    while(base<leafCount)
+        base*=2;
+    if(base>capacity)
     {
-        return ArrayMaxHeap<T>::peekTop();
+        delete[] values;
+        delete[] winner;
+        values=new int[base];
+        winner=new int[2*base];
+        capacity=base;
     }
-    catch(runtime_error e)
+    for(int i=0;i<base;i++)
     {
-        throw runtime_error("Attemped peek into an empty priority queue.");
+        values[i]=0;
+        winner[base+i]=(i<leafCount)?i:-1;
     }
+    for(int node=base-1;node>=1;node--)
+        winner[node]=play(winner[2*node],winner[2*node+1]);
 }
 
-//Heap_PriorityQueue======================================================================================
+TournamentTree::~TournamentTree()
+{
+    delete[] values;
+    delete[] winner;
+}
 
-//Customer================================================================================================
+void TournamentTree::update(int index,int value)
+{
+    values[index]=value;
+    for(int node=(base+index)/2;node>=1;node/=2)
+        winner[node]=play(winner[2*node],winner[2*node+1]);
+}
 
-Customer::Customer():name(""),arrive_time(0),start_time(0),end_time(0),time_need(0),business(false),wait(0){}
+int TournamentTree::getWinner()const
+{
+    if(leafCount==0)
+        return -1;
+    return winner[1];
+}
 
-Customer::Customer(string name,int arrive_time,int time_need,bool business)
+int TournamentTree::getValue(int index)const
 {
-    this->name=name;
-    this->arrive_time=arrive_time;
-    this->start_time=0;
-    this->time_need=time_need;
-    this->business=business;
-    this->wait=0;
-    this->end_time=0;
+    return values[index];
 }
-bool Customer::operator>(const Customer &c)
+
+//HashTable===============================================================================================
+
+template <typename K,typename V>
+int HashTable<K,V>::getHomeIndex(const K &key)const
 {
-    if(this->end_time>c.end_time)
-        return true;
-    if(this->end_time==c.end_time)
-        if(this->arrive_time>c.arrive_time)
-            return true;
-    return false;
+    return hash<K>()(key)&(maxItems-1);
 }
-bool Customer::operator<(const Customer &c)
+template <typename K,typename V>
+int HashTable<K,V>::getIndex(const K &key)const
 {
-    if(this->end_time<c.end_time)
-        return true;
-    if(this->end_time==c.end_time)
-        if(this->arrive_time<c.arrive_time)
-            return true;
-    return false;
+    int index=getHomeIndex(key);
+    while(used[index])                          //linear probing, the table is never full
+    {
+        if(keys[index]==key)
+            return index;
+        index=(index+1)&(maxItems-1);
+    }
+    return -1;
 }
-bool Customer::operator>=(const Customer &c)
+template <typename K,typename V>
+void HashTable<K,V>::rehash(int newCapacity)
 {
-    return(this->end_time>=c.end_time);
+    K *oldKeys=keys;
+    V *oldValues=values;
+    bool *oldUsed=used;
+    int oldCapacity=maxItems;
+    keys=new K[newCapacity];
+    values=new V[newCapacity];
+    used=new bool[newCapacity];
+    maxItems=newCapacity;
+    itemCount=0;
+    for(int i=0;i<maxItems;i++)
+        used[i]=false;
+    for(int i=0;i<oldCapacity;i++)
+        if(oldUsed[i])
+            add(oldKeys[i],oldValues[i]);
+    delete[] oldKeys;
+    delete[] oldValues;
+    delete[] oldUsed;
 }
-bool Customer::operator<=(const Customer &c)
+template <typename K,typename V>
+HashTable<K,V>::HashTable():itemCount(0),maxItems(DEFAULT_CAPACITY)
 {
-    return(this->end_time<=c.end_time);
+    keys=new K[maxItems];
+    values=new V[maxItems];
+    used=new bool[maxItems];
+    for(int i=0;i<maxItems;i++)
+        used[i]=false;
 }
-bool Customer::operator==(const Customer &c)
+template <typename K,typename V>
+HashTable<K,V>::~HashTable()
 {
-    return(this->end_time==c.end_time);
+    delete[] keys;
+    delete[] values;
+    delete[] used;
+}
+template <typename K,typename V>
+bool HashTable<K,V>::isEmpty()const
+{
+    return itemCount==0;
+}
+template <typename K,typename V>
+int HashTable<K,V>::getSize()const
+{
+    return itemCount;
+}
+template <typename K,typename V>
+bool HashTable<K,V>::add(const K &key,const V &value)
+{
+    int index=getIndex(key);
+    if(index>=0)
+    {
+        values[index]=value;
+        return true;
+    }
+    if(2*(itemCount+1)>maxItems)                //keep the load factor under 1/2
+        rehash(2*maxItems);
+    index=getHomeIndex(key);
+    while(used[index])
+        index=(index+1)&(maxItems-1);
+    keys[index]=key;
+    values[index]=value;
+    used[index]=true;
+    itemCount++;
+    return true;
+}
+template <typename K,typename V>
+V* HashTable<K,V>::find(const K &key)const
+{
+    int index=getIndex(key);
+    if(index<0)
+        return nullptr;
+    return &values[index];
+}
+template <typename K,typename V>
+void HashTable<K,V>::clear()
+{
+    for(int i=0;i<maxItems;i++)
+        used[i]=false;
+    itemCount=0;
 }
 
-//Customer================================================================================================
-
-//Event===================================================================================================
+//HashTable===============================================================================================
 
-Event::Event():name(""),start_time(0),left_time(0){}
+//NameTable===============================================================================================
 
-Event::Event(string name,int start_time,int left_time)
+const char* NameTable::store(string_view name)
 {
-    this->name=name;
-    this->start_time=start_time;
-    this->left_time=left_time;
+    int length=name.size();
+    if(chunkCount==0||chunkUsed+length>CHUNK_SIZE)
+    {
+        if(chunkCount==maxChunks)
+        {
+            char **oldChunks=chunks;
+            maxChunks=(maxChunks==0)?16:2*maxChunks;
+            chunks=new char*[maxChunks];
+            for(int i=0;i<chunkCount;i++)
+                chunks[i]=oldChunks[i];
+            delete[] oldChunks;
+        }
+        chunks[chunkCount++]=new char[length>CHUNK_SIZE?length:CHUNK_SIZE];
+        chunkUsed=0;
+    }
+    char *text=chunks[chunkCount-1]+chunkUsed;
+    memcpy(text,name.data(),length);
+    chunkUsed+=length;
+    return text;
 }
 
-bool Event::operator>(const Event &ev)
+NameTable::NameTable():chunks(nullptr),chunkCount(0),maxChunks(0),chunkUsed(0),names(nullptr),nameCount(0),maxNames(0){}
+
+void NameTable::clear()
 {
-    return(this->left_time>ev.left_time);
+    for(int i=1;i<chunkCount;i++)
+        delete[] chunks[i];
+    if(chunkCount>1)
+        chunkCount=1;
+    chunkUsed=0;
+    nameCount=0;
+    ids.clear();
 }
 
-bool Event::operator<(const Event &ev)
+NameTable::~NameTable()
 {
-    return(this->left_time<ev.left_time);
+    for(int i=0;i<chunkCount;i++)
+        delete[] chunks[i];
+    delete[] chunks;
+    delete[] names;
 }
 
-bool Event::operator>=(const Event &ev)
+int NameTable::intern(string_view name)
 {
-    return(this->left_time>=ev.left_time);
+    int *id=ids.find(name);
+    if(id!=nullptr)
+        return *id;
+    if(nameCount==maxNames)
+    {
+        string_view *oldNames=names;
+        maxNames=(maxNames==0)?256:2*maxNames;
+        names=new string_view[maxNames];
+        for(int i=0;i<nameCount;i++)
+            names[i]=oldNames[i];
+        delete[] oldNames;
+    }
+    names[nameCount]=string_view(store(name),name.size());
+    ids.add(names[nameCount],nameCount);
+    return nameCount++;
 }
 
-bool Event::operator<=(const Event &ev)
+int NameTable::find(string_view name)const
 {
-    return(this->left_time<=ev.left_time);
+    int *id=ids.find(name);
+    if(id==nullptr)
+        return -1;
+    return *id;
 }
 
-bool Event::operator==(const Event &ev)
+string_view NameTable::getName(int id)const
 {
-    return(this->left_time==ev.left_time);
+    return names[id];
 }
 
-//Event===================================================================================================
-
-int main()
+int NameTable::getSize()const
 {
-    int n,m,total_time=0,customer_num=0;
+    return nameCount;
+}
 
-    cin>>m>>n;
+//NameTable===============================================================================================
 
-    LinkedQueue<Customer> *normal_line,*business_line;
-    Heap_PriorityQueue<Event> event_list;
-    Heap_PriorityQueue<Customer> customer_list;
+//HeapStorage=============================================================================================
 
-    bool *normal_counter,*business_counter;
+template <typename S>
+DynamicStorage<S>::DynamicStorage():slots(nullptr),capacity(0){}
+template <typename S>
+DynamicStorage<S>::~DynamicStorage()
+{
+    operator delete(slots);
+}
+template <typename S>
+S* DynamicStorage<S>::data()const
+{
+    return slots;
+}
+template <typename S>
+int DynamicStorage<S>::getCapacity()const
+{
+    return capacity;
+}
+template <typename S>
+bool DynamicStorage<S>::reallocate(int newCapacity,int count)
+{
+    if(count>newCapacity)
+        return false;
+    S *newSlots=nullptr;
+    if(newCapacity>0)
+        newSlots=static_cast<S*>(operator new(sizeof(S)*newCapacity));
+    for (int i=0;i<count;i++)
+    {
+        new(&newSlots[i]) S(move(slots[i]));
+        slots[i].~S();
+    }
+    operator delete(slots);
+    slots=newSlots;
+    capacity=newCapacity;
+    return true;
+}
 
-    normal_line=new LinkedQueue<Customer>[m];
-    business_line=new LinkedQueue<Customer>[n];
-    normal_counter=new bool[m];
-    business_counter=new bool[n];
+template <int CAPACITY>
+template <typename S>
+S* FixedStorage<CAPACITY>::Of<S>::data()
+{
+    return reinterpret_cast<S*>(buffer);
+}
+template <int CAPACITY>
+template <typename S>
+int FixedStorage<CAPACITY>::Of<S>::getCapacity()const
+{
+    return CAPACITY;
+}
+template <int CAPACITY>
+template <typename S>
+bool FixedStorage<CAPACITY>::Of<S>::reallocate(int newCapacity,int count)
+{
+    return count<=newCapacity&&newCapacity<=CAPACITY;
+}
 
-    for(int i=0;i<m;i++)
-        normal_counter[i]=false;
-    for(int i=0;i<n;i++)
-        business_counter[i]=false;
+//HeapStorage=============================================================================================
 
-    char statement[1000]={0};
+//ArrayMaxHeap============================================================================================
 
-    cin.get();
-    while(cin.getline(statement,sizeof(statement)))
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+int ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::getFirstChildIndex(const int nodeIndex)const
+{
+    return (ARITY*nodeIndex)+1;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+int ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::getParentIndex(const int nodeIndex) const
+{
+    return (nodeIndex-1)/ARITY;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+bool ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::isLeaf(int nodeIndex) const
+{
+    return !(getFirstChildIndex(nodeIndex)<itemCount);
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+bool ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::isBefore(const HeapSlot<T> &a,const HeapSlot<T> &b)const
+{
+    if(COMPARE()(a.item,b.item))
+        return true;
+    if(COMPARE()(b.item,a.item))
+        return false;
+    return a.order<b.order;                     //equal items leave in the order they came
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+int ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::getBestChildIndex(int nodeIndex)const
+{
+    int bestChildIndex=getFirstChildIndex(nodeIndex);
+    int lastChildIndex=bestChildIndex+ARITY-1;
+    if(lastChildIndex>=itemCount)
+        lastChildIndex=itemCount-1;
+    for(int childIndex=bestChildIndex+1;childIndex<=lastChildIndex;childIndex++)
+        if(isBefore(Items[childIndex],Items[bestChildIndex]))
+            bestChildIndex=childIndex;
+    return bestChildIndex;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+void ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::siftUp(int holeIndex,HeapSlot<T> &slot)
+{
+    while(holeIndex>ROOT_INDEX)
     {
-        if(strlen(statement)==0)
+        int parentIndex=getParentIndex(holeIndex);
+        if(!isBefore(slot,Items[parentIndex]))
             break;
+        PERF_COUNT(PERF_SIFT_STEPS,1);
+        Items[holeIndex]=move(Items[parentIndex]);
+        holeIndex=parentIndex;
+    }
+    Items[holeIndex]=move(slot);
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+void ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::heapRebuild(int subTreeRootIndex)
+{
+    HeapSlot<T> slot=move(Items[subTreeRootIndex]);
+    int holeIndex=subTreeRootIndex;
+    while(!isLeaf(holeIndex))
+    {
+        int bestChildIndex=getBestChildIndex(holeIndex);
+        if(!isBefore(Items[bestChildIndex],slot))
+            break;
+        PERF_COUNT(PERF_SIFT_STEPS,1);
+        Items[holeIndex]=move(Items[bestChildIndex]);
+        holeIndex=bestChildIndex;
+    }
+    Items[holeIndex]=move(slot);
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+void ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::heapCreate()
+{
+    if(itemCount<2)
+        return;
+    for (int index=getParentIndex(itemCount-1);index>=ROOT_INDEX;index--)
+    {
+        heapRebuild(index);
+    }
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+bool ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::reallocate(int newCapacity)
+{
+    if(!storage.reallocate(newCapacity,itemCount))
+        return false;
+    Items=storage.data();
+    maxItems=storage.getCapacity();
+    return true;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::ArrayMaxHeap():itemCount(0),minItems(0),addCount(0)
+{
+    Items=storage.data();
+    maxItems=storage.getCapacity();
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::ArrayMaxHeap(const T someArray[],const int arraySize):itemCount(0),minItems(0),addCount(0)
+{
+    Items=storage.data();
+    maxItems=storage.getCapacity();
+    if(arraySize>maxItems)
+        reallocate(2*arraySize);
+    for (int i=0;i<arraySize&&i<maxItems;i++)                       //fixed storage keeps what fits, as add() would
+    {
+        new(&Items[i]) HeapSlot<T>();
+        Items[i].item=someArray[i];
+        Items[i].order=addCount++;
+        itemCount++;
+    }
+    heapCreate();
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::~ArrayMaxHeap()
+{
+    clear();
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+int ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::getNumberOfNodes()const
+{
+    return itemCount;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+int ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::getHeight()const
+{
+    int height=0;
+    for (long long levelEnd=0;levelEnd<itemCount;levelEnd=levelEnd*ARITY+1)
+        height++;
+    return height;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+const T& ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::peekTop()const
+{
+    assert(!this->isEmpty());
+    return Items[ROOT_INDEX].item;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+bool ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::add(const T& newData)
+{
+    return add(T(newData));
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+template <typename... Args>
+bool ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::emplace(Args&&... args)
+{
+    return add(T(forward<Args>(args)...));
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+T ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::pop()
+{
+    assert(!this->isEmpty());
+    T top=move(Items[ROOT_INDEX].item);
+    remove();
+    return top;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+bool ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::add(T &&newData)
+{
+    if (itemCount==maxItems&&!reallocate(maxItems<DEFAULT_CAPACITY?DEFAULT_CAPACITY:2*maxItems))
+        return false;                                               //fixed storage is full
+    HeapSlot<T> slot;
+    slot.item=move(newData);
+    slot.order=addCount++;
+    new(&Items[itemCount]) HeapSlot<T>();
+    itemCount++;
+    siftUp(itemCount-1,slot);
+    return true;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+bool ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::remove()
+{
+    if(this->isEmpty())
+        return false;
+    itemCount--;
+    int holeIndex=ROOT_INDEX;                   //Floyd: walk the hole down to a leaf first,
+    while(!isLeaf(holeIndex))                   //then bring the last item up from there
+    {
+        int bestChildIndex=getBestChildIndex(holeIndex);
+        PERF_COUNT(PERF_SIFT_STEPS,1);
+        Items[holeIndex]=move(Items[bestChildIndex]);
+        holeIndex=bestChildIndex;
+    }
+    if(holeIndex!=itemCount)
+    {
+        HeapSlot<T> last=move(Items[itemCount]);
+        siftUp(holeIndex,last);
+    }
+    Items[itemCount].~HeapSlot<T>();
+    if(STORAGE<HeapSlot<T>>::RESIZABLE&&maxItems>DEFAULT_CAPACITY&&maxItems>minItems&&4*itemCount<maxItems)
+        reallocate(maxItems/2>minItems?maxItems/2:minItems);  //give memory back once the heap has drained
+    return true;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+void ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::clear()
+{
+    for (int i=0;i<itemCount;i++)
+        Items[i].~HeapSlot<T>();
+    itemCount=0;
+}
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+void ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>::reserve(int capacity)
+{
+    if(capacity>minItems)
+        minItems=capacity;
+    if(capacity>maxItems&&STORAGE<HeapSlot<T>>::RESIZABLE)
+        reallocate(capacity);
+}
 
-        char *cut=nullptr;
-        int arrive_time;
-        char *code,*name;
-
-        cut=strtok(statement," ");
-        string st=cut;
-        arrive_time=time_to_second(st);
-
-        if(!event_list.isEmpty())                               //handle event list
-        {
-            while(arrive_time>=event_list.peek().left_time)
-            {
-                Event ev=event_list.peek();
-                for(int i=0;i<m+n;i++)
-                {
-                    if(i<n)                                     //business counter
-                    {
-                        if(business_counter[i]&&!business_line[i].peekFront().name.compare(ev.name))
-                        {
-                            Customer temp=business_line[i].peekFront();
-                            temp.wait+=ev.start_time-temp.arrive_time;
-                            total_time+=temp.wait;
-                            business_line[i].dequeue();
-                            customer_num++;
-                            temp.start_time=ev.start_time;
-                            temp.end_time=ev.left_time;
-                            customer_list.add(temp);
-                            event_list.remove();
-                            if(!business_line[i].isEmpty())
-                            {
-                                Event new_ev(business_line[i].peekFront().name,temp.end_time,temp.end_time+business_line[i].peekFront().time_need);
-                                event_list.add(new_ev);
-                            }
-                            else
-                                business_counter[i]=false;
-                            break;
-                        }
-                    }
-                    else                                        //normal counter
-                    {
-                        if(normal_counter[i-n]&&!normal_line[i-n].peekFront().name.compare(ev.name))
-                        {
-                            Customer temp=normal_line[i-n].peekFront();
-                            temp.wait+=ev.start_time-temp.arrive_time;
-                            total_time+=temp.wait;
-                            normal_line[i-n].dequeue();
-                            customer_num++;
-                            temp.start_time=ev.start_time;
-                            temp.end_time=ev.left_time;
-                            customer_list.add(temp);
-                            event_list.remove();
-                            if(!normal_line[i-n].isEmpty())
-                            {
-                                Event new_ev(normal_line[i-n].peekFront().name,temp.end_time,temp.end_time+normal_line[i-n].peekFront().time_need);
-                                event_list.add(new_ev);
-                            }
-                            else
-                                normal_counter[i-n]=false;
-                            break;
-                        }
-                    }
-                }
-                if(event_list.isEmpty())
-                    break;
-            }
-        }
-        code=strtok(NULL," ");
-        if(!strcmp(code,"A"))                                       //arrival event
-        {
-            char *type;
-            int time_need;
-            bool business=true;
+//ArrayMaxHeap============================================================================================
 
-            name=strtok(NULL," ");
-            type=strtok(NULL," ");
-            cut=strtok(NULL," ");
-            time_need=stoi(cut);
-            if(strcmp(type,"B"))
-                business=false;
-            Customer cus(name,arrive_time,time_need,business);
-            int short_lengh=1000000,short_id=-1;
+//Heap_PriorityQueue======================================================================================
 
-            for(int i=0;i<n+m;i++)                                  //check every counter
-            {
-                if(!cus.business&&i<n)
-                    continue;
-                int num=0;
-                if(i>=n)
-                    num=normal_line[i-n].get_size();
-                else
-                    num=business_line[i].get_size();
-                if(num<short_lengh)
-                    short_lengh=num,short_id=i;
-            }
+template <typename T,typename COMPARE,int ARITY,template <typename> class STORAGE>
+Heap_PriorityQueue<T,COMPARE,ARITY,STORAGE>::Heap_PriorityQueue():ArrayMaxHeap<T,COMPARE,ARITY,STORAGE>(),PriorityQueueInterface<Heap_PriorityQueue<T,COMPARE,ARITY,STORAGE>,T>(){}
 
-            if(short_id>=n)                                         //add to normal counter
-            {
-                short_id-=n;
-                if(!normal_counter[short_id])
-                {
-                    normal_counter[short_id]=true;
-                    Event ev(name,arrive_time,arrive_time+time_need);
-                    event_list.add(ev);
-                    cus.start_time=arrive_time;
-                }
-                normal_line[short_id].enqueue(cus);
-            }
-            else                                                    //add to busineess counter
-            {
-                if(!business_counter[short_id])
-                {
-                    business_counter[short_id]=true;
-                    Event ev(name,arrive_time,arrive_time+time_need);
-                    event_list.add(ev);
-                    cus.start_time=arrive_time;
-                }
-                business_line[short_id].enqueue(cus);
-            }
+//Heap_PriorityQueue======================================================================================
 
-        }
+//TimingWheel=============================================================================================
 
-        else if(!strcmp(code,"D"))                                  //departure event
+template <typename T,typename KEY,int BITS>
+bool TimingWheel<T,KEY,BITS>::KeyBefore::operator()(const T &a,const T &b)const
+{
+    return KEY()(a)<KEY()(b);
+}
+template <typename T,typename KEY,int BITS>
+TimingWheel<T,KEY,BITS>::TimingWheel():freeNode(-1),base(0),cursor(0),wheelCount(0)
+{
+    for(int i=0;i<SLOT_COUNT;i++)
+        head[i]=tail[i]=-1;
+    memset(occupied,0,sizeof(occupied));
+}
+template <typename T,typename KEY,int BITS>
+int TimingWheel<T,KEY,BITS>::findFirst()const
+{
+    while(true)                                                     //the scan only moves forward between adds
+    {
+        int slot=cursor&MASK;
+        unsigned long long bits=occupied[slot>>6]>>(slot&63);
+        if(bits)
         {
-            name=strtok(NULL," ");
-            bool found=false;
-
-            for(int i=0;i<m+n;i++)
-            {
-                if(i<n&&!found)                                     //business counter
-                {
-                    int size=business_line[i].get_size();
-                    for(int j=0;j<size;j++)
-                    {
-                        if(business_line[i].peekFront().name.compare(name))
-                            business_line[i].enqueue(business_line[i].peekFront());
-                        else if(!business_line[i].peekFront().name.compare(name)&&j==0)
-                        {
-                            found=true;
-                            business_line[i].enqueue(business_line[i].peekFront());
-                        }
-                        else
+            cursor+=__builtin_ctzll(bits);
+            return head[cursor&MASK];
+        }
+        cursor+=64-(slot&63);
+    }
+}
+template <typename T,typename KEY,int BITS>
+void TimingWheel<T,KEY,BITS>::push(int key,T &&item)
+{
+    int index=freeNode;
+    if(index==-1)
+    {
+        index=nodes.size();
+        nodes.push_back(WheelNode());
+    }
+    else
+        freeNode=nodes[index].next;
+    nodes[index].item=move(item);
+    nodes[index].next=-1;
+    int slot=key&MASK;
+    if(tail[slot]==-1)
+    {
+        head[slot]=index;
+        occupied[slot>>6]|=1ULL<<(slot&63);
+    }
+    else
+        nodes[tail[slot]].next=index;
+    tail[slot]=index;
+    wheelCount++;
+    if(key<cursor)
+        cursor=key;
+}
+template <typename T,typename KEY,int BITS>
+void TimingWheel<T,KEY,BITS>::advance(int key)
+{
+    if(key<=base)
+        return;
+    base=key;
+    if(cursor<base)
+        cursor=base;
+    while(!overflow.isEmpty()&&KEY()(overflow.peek())<base+SLOT_COUNT)    //slots entering the window are empty,
+    {                                                                       //so equal keys keep their order
+        int k=KEY()(overflow.peek());
+        push(k,overflow.pop());
+    }
+}
+template <typename T,typename KEY,int BITS>
+bool TimingWheel<T,KEY,BITS>::isEmpty()const
+{
+    return wheelCount==0&&overflow.isEmpty();
+}
+template <typename T,typename KEY,int BITS>
+int TimingWheel<T,KEY,BITS>::get_size()const
+{
+    return wheelCount+overflow.getNumberOfNodes();
+}
+template <typename T,typename KEY,int BITS>
+const T& TimingWheel<T,KEY,BITS>::peekTop()const
+{
+    assert(!isEmpty());
+    if(wheelCount==0)
+        return overflow.peek();
+    return nodes[findFirst()].item;
+}
+template <typename T,typename KEY,int BITS>
+bool TimingWheel<T,KEY,BITS>::add(const T &newEntry)
+{
+    return add(T(newEntry));
+}
+template <typename T,typename KEY,int BITS>
+bool TimingWheel<T,KEY,BITS>::add(T &&newEntry)
+{
+    int key=KEY()(newEntry);
+    assert(key>=base);
+    if(key<base+SLOT_COUNT)
+        push(key,move(newEntry));
+    else
+        overflow.add(move(newEntry));
+    return true;
+}
+template <typename T,typename KEY,int BITS>
+template <typename... Args>
+bool TimingWheel<T,KEY,BITS>::emplace(Args&&... args)
+{
+    return add(T(forward<Args>(args)...));
+}
+template <typename T,typename KEY,int BITS>
+bool TimingWheel<T,KEY,BITS>::remove()
+{
+    if(isEmpty())
+        return false;
+    pop();
+    return true;
+}
+template <typename T,typename KEY,int BITS>
+T TimingWheel<T,KEY,BITS>::pop()
+{
+    assert(!isEmpty());
+    if(wheelCount==0)                                               //everything is far ahead, jump to it
+    {
+        T top=overflow.pop();
+        advance(KEY()(top));
+        return top;
+    }
+    int index=findFirst();
+    int slot=cursor&MASK;
+    head[slot]=nodes[index].next;
+    if(head[slot]==-1)
+    {
+        tail[slot]=-1;
+        occupied[slot>>6]&=~(1ULL<<(slot&63));
+    }
+    nodes[index].next=freeNode;
+    freeNode=index;
+    wheelCount--;
+    T top=move(nodes[index].item);
+    advance(cursor);
+    return top;
+}
+template <typename T,typename KEY,int BITS>
+void TimingWheel<T,KEY,BITS>::clear()
+{
+    nodes.clear();
+    freeNode=-1;
+    for(int i=0;i<SLOT_COUNT;i++)
+        head[i]=tail[i]=-1;
+    memset(occupied,0,sizeof(occupied));
+    base=0;
+    cursor=0;
+    wheelCount=0;
+    overflow.clear();
+}
+template <typename T,typename KEY,int BITS>
+void TimingWheel<T,KEY,BITS>::reserve(int capacity)
+{
+    nodes.reserve(capacity);
+    overflow.reserve(capacity);
+}
+
+//TimingWheel=============================================================================================
+
+//Customer================================================================================================
+
+constexpr Customer::Customer():name(-1),arrive_time(0),start_time(0),end_time(0),time_need(0),business(false),wait(0){}
+
+constexpr Customer::Customer(int name,int arrive_time,int time_need,bool business):name(name),arrive_time(arrive_time),start_time(0),end_time(0),time_need(time_need),business(business),wait(0){}
+
+constexpr bool Customer::operator>(const Customer &c)const
+{
+    return CustomerBefore()(c,*this);
+}
+constexpr bool Customer::operator<(const Customer &c)const
+{
+    return CustomerBefore()(*this,c);
+}
+bool Customer::operator>=(const Customer &c)const
+{
+    return(this->end_time>=c.end_time);
+}
+bool Customer::operator<=(const Customer &c)const
+{
+    return(this->end_time<=c.end_time);
+}
+bool Customer::operator==(const Customer &c)const
+{
+    return(this->end_time==c.end_time);
+}
+
+//Customer================================================================================================
+
+//Event===================================================================================================
+
+constexpr Event::Event():customer(-1),start_time(0),left_time(0),business(false),counter(-1){}
+
+constexpr Event::Event(int customer,int start_time,int left_time,bool business,int counter):customer(customer),start_time(start_time),left_time(left_time),business(business),counter(counter){}
+
+constexpr bool Event::operator>(const Event &ev)const
+{
+    return EventBefore()(ev,*this);
+}
+
+constexpr bool Event::operator<(const Event &ev)const
+{
+    return EventBefore()(*this,ev);
+}
+
+bool Event::operator>=(const Event &ev)const
+{
+    return(this->left_time>=ev.left_time);
+}
+
+bool Event::operator<=(const Event &ev)const
+{
+    return(this->left_time<=ev.left_time);
+}
+
+bool Event::operator==(const Event &ev)const
+{
+    return(this->left_time==ev.left_time);
+}
+
+//Event===================================================================================================
+
+//Comparators=============================================================================================
+
+constexpr bool EventBefore::operator()(const Event &a,const Event &b)const
+{
+    return a.left_time<b.left_time;
+}
+
+constexpr bool CustomerBefore::operator()(const Customer &a,const Customer &b)const
+{
+    return a.end_time<b.end_time||(a.end_time==b.end_time&&a.arrive_time<b.arrive_time);
+}
+
+constexpr int EventTime::operator()(const Event &ev)const
+{
+    return ev.left_time;
+}
+
+static_assert(EventBefore()(Event(0,0,5,false,0),Event(1,0,6,false,0)),"EventBefore orders by left_time");
+static_assert(CustomerBefore()(Customer(0,1,0,false),Customer(1,2,0,false)),"equal end_time falls back to arrive_time");
+static_assert(sizeof(BinaryHeader)==32&&sizeof(BinaryRecord)==16,"the binary trace layout is fixed");
+
+//Comparators=============================================================================================
+
+//CustomerTable===========================================================================================
+
+CustomerTable::CustomerTable():freeList(-1),liveCount(0){}
+
+int CustomerTable::add(int name,int arrive_time,int time_need,bool business)
+{
+    int index=freeList;
+    if(index>=0)
+    {
+        freeList=nextFree[index];
+        this->name[index]=name;
+        this->arrive_time[index]=arrive_time;
+        this->start_time[index]=0;
+        this->end_time[index]=0;
+        this->time_need[index]=time_need;
+        this->wait[index]=0;
+        this->business[index]=business;
+        place[index]=Locator();
+        nextSame[index]=-1;
+        prevSame[index]=-1;
+    }
+    else
+    {
+        index=this->name.size();
+        nextFree.push_back(-1);
+        this->name.push_back(name);
+        this->arrive_time.push_back(arrive_time);
+        this->start_time.push_back(0);
+        this->end_time.push_back(0);
+        this->time_need.push_back(time_need);
+        this->wait.push_back(0);
+        this->business.push_back(business);
+        place.push_back(Locator());
+        nextSame.push_back(-1);
+        prevSame.push_back(-1);
+    }
+    liveCount++;
+    return index;
+}
+
+void CustomerTable::release(int index)
+{
+    nextFree[index]=freeList;
+    freeList=index;
+    liveCount--;
+}
+
+int CustomerTable::getSize()const
+{
+    return liveCount;
+}
+
+void CustomerTable::reserve(int capacity)
+{
+    nextFree.reserve(capacity);
+    name.reserve(capacity);
+    arrive_time.reserve(capacity);
+    start_time.reserve(capacity);
+    end_time.reserve(capacity);
+    time_need.reserve(capacity);
+    wait.reserve(capacity);
+    business.reserve(capacity);
+    place.reserve(capacity);
+    nextSame.reserve(capacity);
+    prevSame.reserve(capacity);
+}
+
+void CustomerTable::clear()
+{
+    nextFree.clear();
+    name.clear();
+    arrive_time.clear();
+    start_time.clear();
+    end_time.clear();
+    time_need.clear();
+    wait.clear();
+    business.clear();
+    place.clear();
+    nextSame.clear();
+    prevSame.clear();
+    freeList=-1;
+    liveCount=0;
+}
+
+//CustomerTable===========================================================================================
+
+//Locator=================================================================================================
+
+Locator::Locator():line(-1),handle(-1){}
+
+Locator::Locator(int line,long long handle):line(line),handle(handle){}
+
+//Locator=================================================================================================
+
+//Record==================================================================================================
+
+Record::Record():time(0),code('A'),name_id(-1),business(false),value(0){}
+
+//Record==================================================================================================
+
+//OutputWriter============================================================================================
+
+void OutputWriter::makeRoom(int bytes)
+{
+    if(used+bytes>BUFFER_SIZE)
+        flush();
+}
+
+OutputWriter::OutputWriter(FILE *file):used(0),file(file)
+{
+    buffer=new char[BUFFER_SIZE];
+}
+
+OutputWriter::~OutputWriter()
+{
+    flush();
+    delete[] buffer;
+}
+
+void OutputWriter::write(const char *text,int length)
+{
+    if(length>BUFFER_SIZE)
+    {
+        flush();
+        fwrite(text,1,length,file);
+        return;
+    }
+    makeRoom(length);
+    memcpy(buffer+used,text,length);
+    used+=length;
+}
+
+void OutputWriter::write(const string &text)
+{
+    write(text.data(),text.size());
+}
+
+void OutputWriter::write(char c)
+{
+    makeRoom(1);
+    buffer[used++]=c;
+}
+
+void OutputWriter::writeTime(int t)
+{
+    makeRoom(32);
+    used+=format_time(t,buffer+used);
+}
+
+void OutputWriter::writeInt(long long value)
+{
+    makeRoom(32);
+    used+=snprintf(buffer+used,32,"%lld",value);
+}
+
+void OutputWriter::writeDouble(double value)
+{
+    makeRoom(64);
+    used+=snprintf(buffer+used,64,"%g",value);
+}
+
+void OutputWriter::flush()
+{
+    PERF_SCOPE(PERF_OUTPUT);
+    if(used>0)
+        fwrite(buffer,1,used,file);
+    used=0;
+    fflush(file);
+}
+
+//OutputWriter============================================================================================
+
+//CompletionEmitter=======================================================================================
+
+void CompletionEmitter::sortBatch(int last)
+{
+    int count=last-first;
+    batch.resize(count);
+    bool sorted=true;
+    for(int i=0;i<count;i++)
+    {
+        int c=pending[first+i];
+        batch[i].key=(unsigned long long)((unsigned int)customers->end_time[c]^0x80000000u)<<32|((unsigned int)customers->arrive_time[c]^0x80000000u);
+        batch[i].customer=c;
+        if(i>0&&batch[i].key<batch[i-1].key)                        //end_time already only grows, often nothing to do
+            sorted=false;
+    }
+    if(sorted)
+        return;
+    if(count<SMALL_BATCH)
+    {
+        for(int i=1;i<count;i++)
+        {
+            SortItem item=batch[i];
+            int j=i;
+            for(;j>0&&item.key<batch[j-1].key;j--)
+                batch[j]=batch[j-1];
+            batch[j]=item;
+        }
+        return;
+    }
+    int buckets[8][256];                                            //LSD radix, a byte per pass
+    memset(buckets,0,sizeof(buckets));
+    for(int i=0;i<count;i++)
+        for(int pass=0;pass<8;pass++)
+            buckets[pass][(batch[i].key>>(8*pass))&0xff]++;
+    scratch.resize(count);
+    SortItem *from=batch.data();
+    SortItem *to=scratch.data();
+    for(int pass=0;pass<8;pass++)
+    {
+        int *bucket=buckets[pass];
+        if(bucket[(from[0].key>>(8*pass))&0xff]==count)             //every key has the same byte here
+            continue;
+        int offset=0;
+        for(int d=0;d<256;d++)
+        {
+            int size=bucket[d];
+            bucket[d]=offset;
+            offset+=size;
+        }
+        for(int i=0;i<count;i++)
+            to[bucket[(from[i].key>>(8*pass))&0xff]++]=from[i];
+        swap(from,to);
+    }
+    if(from!=batch.data())
+        batch.swap(scratch);
+}
+
+void CompletionEmitter::emitBatch(int last)
+{
+    PERF_SCOPE(PERF_EMIT);
+    sortBatch(last);
+    for(int i=0;i<last-first;i++)
+    {
+        int c=batch[i].customer;
+        if(callback!=nullptr)
+            callback(context,(*names)[customers->name[c]],customers->start_time[c],customers->end_time[c]);
+        customers->release(c);
+    }
+    first=last;
+    if(first==(int)pending.size())
+    {
+        pending.clear();
+        first=0;
+    }
+    else if(2*first>=(int)pending.size())                           //drop the printed half so pending stays small
+    {
+        pending.erase(pending.begin(),pending.begin()+first);
+        first=0;
+    }
+}
+
+CompletionEmitter::CompletionEmitter(const vector<string_view> *names,CustomerTable *customers):first(0),callback(nullptr),context(nullptr),names(names),customers(customers){}
+
+void CompletionEmitter::setCallback(CompletionCallback callback,void *context)
+{
+    this->callback=callback;
+    this->context=context;
+}
+
+void CompletionEmitter::add(int customer)
+{
+    assert((int)pending.size()==first||customers->end_time[pending.back()]<=customers->end_time[customer]);
+    pending.push_back(customer);
+}
+
+void CompletionEmitter::reserve(int capacity)
+{
+    pending.reserve(capacity);
+}
+
+void CompletionEmitter::reset()
+{
+    pending.clear();
+    first=0;
+}
+
+void CompletionEmitter::emitBefore(int watermark)
+{
+    int last=first;                                                 //end_time only grows, so the batch is a prefix
+    while(last<(int)pending.size()&&customers->end_time[pending[last]]<watermark)
+        last++;
+    if(last>first)
+        emitBatch(last);
+}
+
+void CompletionEmitter::emitAll()
+{
+    emitBatch(pending.size());
+}
+
+//CompletionEmitter=======================================================================================
+
+//BankSimulator===========================================================================================
+
+BankSimulator::BankSimulator():m(0),n(0),lines(nullptr),lineCapacity(0),normal_shortest(0),business_shortest(0),customer_list(&nameText,&customers),total_time(0),customer_num(0),first_time(-1),last_time(0){}
+
+BankSimulator::~BankSimulator()
+{
+    delete[] lines;
+}
+
+void BankSimulator::configure(int m,int n)
+{
+    this->m=m;
+    this->n=n;
+    if(m+n>lineCapacity)
+    {
+        delete[] lines;
+        lines=new ArrayQueue<int>[m+n];
+        lineCapacity=m+n;
+    }
+    event_list.reserve(m+n);                                        //at most one event per busy counter
+    reset();
+}
+
+void BankSimulator::reserve(int customers)
+{
+    customer_list.reserve(customers);
+    this->customers.reserve(customers);
+}
+
+void BankSimulator::setCompletionCallback(CompletionCallback callback,void *context)
+{
+    customer_list.setCallback(callback,context);
+}
+
+void BankSimulator::reset()
+{
+    for(int i=0;i<m+n;i++)
+        lines[i].clear();
+    busy.assign(m+n,false);
+    normal_shortest.reset(m);
+    business_shortest.reset(n);
+    event_list.clear();
+    names.clear();
+    nameText.clear();
+    customers.clear();
+    customer_list.reset();
+    waiting.clear();
+    total_time=0;
+    customer_num=0;
+    first_time=-1;
+    last_time=0;
+    busy_time.assign(m+n,0);
+}
+
+void BankSimulator::updateLength(int line)
+{
+    if(line<n)
+        business_shortest.update(line,lines[line].get_size());
+    else
+        normal_shortest.update(line-n,lines[line].get_size());
+}
+
+int BankSimulator::internName(const Record &record)
+{
+    int name=record.name_id;
+    if(name<0)
+    {
+        name=names.intern(record.name);
+        if(name==(int)nameText.size())
+            nameText.push_back(names.getName(name));
+    }
+    else                                                            //interned already by the producer, text kept by it
+    {
+        if(name>=(int)nameText.size())
+            nameText.resize(name+1);
+        nameText[name]=record.name;
+    }
+    if(name>=(int)waiting.size())
+        waiting.resize(name+1,-1);
+    return name;
+}
+
+int BankSimulator::findName(const Record &record)const
+{
+    int name=(record.name_id<0)?names.find(record.name):record.name_id;
+    return name<(int)waiting.size()?name:-1;
+}
+
+void BankSimulator::link(int c)
+{
+    int name=customers.name[c];
+    customers.prevSame[c]=-1;
+    customers.nextSame[c]=waiting[name];
+    if(waiting[name]>=0)
+        customers.prevSame[waiting[name]]=c;
+    waiting[name]=c;
+}
+
+void BankSimulator::unlink(int c)
+{
+    int prev=customers.prevSame[c],next=customers.nextSame[c];
+    if(prev>=0)
+        customers.nextSame[prev]=next;
+    else
+        waiting[customers.name[c]]=next;
+    if(next>=0)
+        customers.prevSame[next]=prev;
+    customers.place[c].line=-1;
+}
+
+int BankSimulator::findWaiting(int name)
+{
+    matches.clear();
+    if(name<0)
+        return -1;
+    int line=-1;
+    for(int c=waiting[name];c>=0;c=customers.nextSame[c])          //names are nearly always unique, the chain is short
+        if(line<0||customers.place[c].line<line)                    //the scan stops at the first line holding the name, even at its counter
+            line=customers.place[c].line;
+    for(int c=waiting[name];c>=0;c=customers.nextSame[c])
+    {
+        const Locator &loc=customers.place[c];
+        if(loc.line!=line||loc.handle==lines[line].getFrontHandle())    //the one at the counter can not leave
+            continue;
+        int i=matches.size();
+        matches.push_back(c);
+        for(;i>0&&customers.place[matches[i-1]].handle>loc.handle;i--) //in line order, C sizes change as they go
+            matches[i]=matches[i-1];
+        matches[i]=c;
+    }
+    return line;
+}
+
+void BankSimulator::serve(const Event &ev)
+{
+    int line=ev.business?ev.counter:ev.counter+n;
+    ArrayQueue<int> &queue=lines[line];
+    assert(busy[line]&&queue.peekFront()==ev.customer);
+    int c=ev.customer;
+    customers.wait[c]+=ev.start_time-customers.arrive_time[c];
+    total_time+=customers.wait[c];
+    queue.dequeue();
+    updateLength(line);
+    unlink(c);
+    customer_num++;
+    customers.start_time[c]=ev.start_time;
+    customers.end_time[c]=ev.left_time;
+    customer_list.add(c);
+    busy_time[line]+=ev.left_time-ev.start_time;
+    last_time=ev.left_time;                                         //events come out in left_time order
+    if(!queue.isEmpty())
+        event_list.emplace(queue.peekFront(),ev.left_time,ev.left_time+customers.time_need[queue.peekFront()],ev.business,ev.counter);
+    else
+        busy[line]=false;
+}
+
+void BankSimulator::advance_to(int time)
+{
+    if(!event_list.isEmpty())
+    {
+        PERF_SCOPE(PERF_DRAIN);
+        while(!event_list.isEmpty()&&time>=event_list.peek().left_time)
+        {
+            Event ev=event_list.pop();
+            PERF_COUNT(PERF_EVENTS_POPPED,1);
+            serve(ev);
+        }
+    }
+    customer_list.emitBefore(time);                                 //whoever is served from now on ends at time or later
+}
+
+void BankSimulator::finish()
+{
+    if(!event_list.isEmpty())
+    {
+        PERF_SCOPE(PERF_DRAIN);
+        while(!event_list.isEmpty())
+        {
+            Event ev=event_list.pop();
+            PERF_COUNT(PERF_EVENTS_POPPED,1);
+            serve(ev);
+        }
+    }
+    customer_list.emitAll();
+}
+
+void BankSimulator::feed(const Record &record)
+{
+    if(first_time<0)
+        first_time=record.time;
+    advance_to(record.time);
+    if(record.code=='A')
+        arrive(record);
+    else if(record.code=='D')
+        depart(record);
+    else
+        changeLine(record);
+}
+
+void BankSimulator::arrive(const Record &record)
+{
+    PERF_SCOPE(PERF_ROUTE);
+    int arrive_time=record.time;
+    int time_need=record.value;
+    int name=internName(record);
+    int short_id=normal_shortest.getWinner();                       //business lines come first and win ties
+    int short_business=business_shortest.getWinner();
+    if(short_id>=0)
+        short_id+=n;
+    if(record.business&&short_business>=0&&(short_id<0||business_shortest.getValue(short_business)<=normal_shortest.getValue(short_id-n)))
+        short_id=short_business;
+    if(short_id<0)                                                  //no line this customer may join
+        return;
+    int c=customers.add(name,arrive_time,time_need,record.business);
+    if(!busy[short_id])
+    {
+        busy[short_id]=true;
+        event_list.emplace(c,arrive_time,arrive_time+time_need,short_id<n,short_id<n?short_id:short_id-n);
+        customers.start_time[c]=arrive_time;
+    }
+    lines[short_id].enqueue(c);
+    updateLength(short_id);
+    PERF_MAX(PERF_MAX_LINE,lines[short_id].get_size());
+    customers.place[c]=Locator(short_id,lines[short_id].getBackHandle());
+    link(c);
+}
+
+void BankSimulator::depart(const Record &record)
+{
+    PERF_SCOPE(PERF_DEPART);
+    int line=findWaiting(findName(record));
+    for(size_t i=0;i<matches.size();i++)                            //everyone of that name behind the counter leaves
+    {
+        int c=matches[i];
+        lines[line].extract(customers.place[c].handle);
+        total_time+=record.time-customers.arrive_time[c];
+        customer_num++;
+        unlink(c);
+        customers.release(c);
+    }
+    if(!matches.empty())
+        updateLength(line);
+}
+
+void BankSimulator::changeLine(const Record &record)
+{
+    PERF_SCOPE(PERF_CHANGE);
+    int line=record.value;
+    int source=findWaiting(findName(record));
+    if(source<0||line<0||line>=n+m)
+        return;
+    ArrayQueue<int> &from=lines[source];
+    ArrayQueue<int> &to=lines[line];
+    for(size_t i=0;i<matches.size();i++)                            //each one compares the sizes as the ones before left them
+    {
+        int c=matches[i];
+        if(from.get_size()<=to.get_size()||(line<n&&!customers.business[c]))   //only to a shorter line, business lines for business only
+            continue;
+        Locator *loc=&customers.place[c];
+        from.extract(loc->handle);
+        customers.wait[c]+=record.time-customers.arrive_time[c];
+        customers.arrive_time[c]=record.time;
+        if(to.isEmpty())
+        {
+            event_list.emplace(c,record.time,record.time+customers.time_need[c],line<n,(line<n)?line:line-n);
+            busy[line]=true;
+        }
+        to.enqueue(c);
+        updateLength(source);
+        updateLength(line);
+        PERF_MAX(PERF_MAX_LINE,to.get_size());
+        loc->line=line;
+        loc->handle=to.getBackHandle();
+    }
+}
+
+long long BankSimulator::getTotalWait()const
+{
+    return total_time;
+}
+
+int BankSimulator::getCustomerCount()const
+{
+    return customer_num;
+}
+
+int BankSimulator::getMakespan()const
+{
+    return (first_time<0||last_time<first_time)?0:last_time-first_time;
+}
+
+long long BankSimulator::getBusyTime(int line)const
+{
+    return busy_time[line];
+}
+
+long long BankSimulator::getAllocationCount()const
+{
+    long long allocations=0;
+    for(int i=0;i<m+n;i++)
+        allocations+=lines[i].getAllocationCount();
+    return allocations;
+}
+
+//BankSimulator===========================================================================================
+
+//ParsedTrace=============================================================================================
+
+ParsedTrace::ParsedTrace():m(0),n(0){}
+
+bool ParsedTrace::load(InputReader &reader)
+{
+    string_view statement;
+    if(!reader.readLine(statement))
+        return false;
+    m=parse_int(next_token(statement));
+    n=parse_int(next_token(statement));
+    Record record;
+    while(reader.readLine(statement))
+    {
+        if(statement.empty())
+            break;
+        if(parse_record(statement,record))
+            add(record);
+    }
+    return true;
+}
+
+void ParsedTrace::add(Record record)
+{
+    record.name_id=names.intern(record.name);
+    record.name=names.getName(record.name_id);                      //the reader's buffer does not outlive the line
+    records.push_back(record);
+}
+
+//ParsedTrace=============================================================================================
+
+//TaskPool================================================================================================
+
+TaskPool::TaskPool(int workers):workerCount(workers<1?1:workers)
+{
+    queues=new WorkerQueue[workerCount];
+}
+
+TaskPool::~TaskPool()
+{
+    delete[] queues;
+}
+
+int TaskPool::getWorkerCount()const
+{
+    return workerCount;
+}
+
+bool TaskPool::take(int worker,int &task)
+{
+    {
+        lock_guard<mutex> guard(queues[worker].lock);
+        if(!queues[worker].tasks.empty())
+        {
+            task=queues[worker].tasks.back();
+            queues[worker].tasks.pop_back();
+            return true;
+        }
+    }
+    for(int i=1;i<workerCount;i++)                                  //own queue is dry, steal the oldest task of the next one that has any
+    {
+        WorkerQueue &victim=queues[(worker+i)%workerCount];
+        lock_guard<mutex> guard(victim.lock);
+        if(!victim.tasks.empty())
+        {
+            task=victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;                                                   //nothing is added while running, so all is taken
+}
+
+void TaskPool::work(int worker,TaskFunction function,void *context)
+{
+    int task;
+    while(take(worker,task))
+        function(context,worker,task);
+}
+
+void TaskPool::run(int taskCount,TaskFunction function,void *context)
+{
+    for(int w=0;w<workerCount;w++)                                  //a block of neighbouring tasks each, taken from the back
+    {
+        int begin=(long long)taskCount*w/workerCount;
+        int end=(long long)taskCount*(w+1)/workerCount;
+        for(int i=end-1;i>=begin;i--)
+            queues[w].tasks.push_back(i);
+    }
+    vector<thread> threads;
+    for(int w=1;w<workerCount;w++)
+        threads.emplace_back(&TaskPool::work,this,w,function,context);
+    work(0,function,context);
+    for(size_t i=0;i<threads.size();i++)
+        threads[i].join();
+}
+
+//TaskPool================================================================================================
+
+//BatchResult=============================================================================================
+
+BatchResult::BatchResult():m(0),n(0),customers(0),total_wait(0),makespan(0),load_min(0),load_avg(0),load_max(0){}
+
+//BatchResult=============================================================================================
+
+//Branch==================================================================================================
+
+Branch::Branch():id(0),writer(nullptr),output(nullptr),outputSize(0){}
+
+Branch::~Branch()
+{
+    free(output);
+}
+
+//Branch==================================================================================================
+
+//SpscRing================================================================================================
+
+template <typename T>
+SpscRing<T>::SpscRing(int capacity):capacity(1),head(0),tail(0),closed(false)
+{
+    while(this->capacity<(size_t)capacity)
+        this->capacity*=2;
+    items=new T[this->capacity];
+}
+template <typename T>
+SpscRing<T>::~SpscRing()
+{
+    delete[] items;
+}
+template <typename T>
+void SpscRing<T>::push(const T *batch,int count)
+{
+    size_t back=tail.load(memory_order_relaxed);
+    while(count>0)
+    {
+        size_t room=capacity-(back-head.load(memory_order_acquire));
+        if(room==0)
+        {
+            this_thread::yield();
+            continue;
+        }
+        size_t n=min(room,(size_t)count);
+        for(size_t i=0;i<n;i++)
+            items[(back+i)&(capacity-1)]=batch[i];
+        back+=n;
+        batch+=n;
+        count-=n;
+        tail.store(back,memory_order_release);                      //the consumer sees the whole batch at once
+    }
+}
+template <typename T>
+int SpscRing<T>::pop(T *batch,int maxCount)
+{
+    size_t front=head.load(memory_order_relaxed);
+    while(true)
+    {
+        size_t back=tail.load(memory_order_acquire);
+        if(back==front)
+        {
+            if(closed.load(memory_order_acquire)&&tail.load(memory_order_acquire)==front)
+                return 0;
+            this_thread::yield();
+            continue;
+        }
+        size_t n=min(back-front,(size_t)maxCount);
+        for(size_t i=0;i<n;i++)
+            batch[i]=items[(front+i)&(capacity-1)];
+        head.store(front+n,memory_order_release);
+        return n;
+    }
+}
+template <typename T>
+void SpscRing<T>::close()
+{
+    closed.store(true,memory_order_release);
+}
+
+//SpscRing================================================================================================
+
+//Pipeline================================================================================================
+
+Pipeline::Pipeline(InputReader *reader,int m,int n,int reserve):reader(reader),records(RING_SIZE),completions(RING_SIZE),pendingCount(0)
+{
+    bank.configure(m,n);
+    bank.reserve(reserve);
+    bank.setCompletionCallback(complete,this);
+}
+
+void Pipeline::parse()
+{
+    Record batch[BATCH];
+    int count=0;
+    string_view statement;
+    while(reader->readLine(statement))
+    {
+        if(statement.empty())
+            break;
+        if(!parse_record(statement,batch[count]))
+            continue;
+        batch[count].name_id=names.intern(batch[count].name);       //hashed here, so the simulator thread does not
+        batch[count].name=names.getName(batch[count].name_id);      //the reader's buffer moves on, the arena does not
+        if(++count==BATCH)
+        {
+            records.push(batch,count);
+            count=0;
+        }
+    }
+    records.push(batch,count);
+    records.close();
+}
+
+void Pipeline::simulate()
+{
+    Record batch[BATCH];
+    int count;
+    while((count=records.pop(batch,BATCH))>0)
+        for(int i=0;i<count;i++)
+            bank.feed(batch[i]);
+    bank.finish();
+    completions.push(pending,pendingCount);
+    pendingCount=0;
+    completions.close();
+}
+
+void Pipeline::complete(void *context,string_view name,int start_time,int end_time)
+{
+    Pipeline *pipeline=(Pipeline*)context;
+    Completion &completion=pipeline->pending[pipeline->pendingCount++];
+    completion.name=name;
+    completion.start_time=start_time;
+    completion.end_time=end_time;
+    if(pipeline->pendingCount==BATCH)
+    {
+        pipeline->completions.push(pipeline->pending,BATCH);
+        pipeline->pendingCount=0;
+    }
+}
+
+void Pipeline::run(OutputWriter &writer)
+{
+    thread parser(&Pipeline::parse,this);
+    thread simulator(&Pipeline::simulate,this);
+    Completion batch[BATCH];
+    int count;
+    while((count=completions.pop(batch,BATCH))>0)
+        for(int i=0;i<count;i++)
+            write_completion(&writer,batch[i].name,batch[i].start_time,batch[i].end_time);
+    parser.join();
+    simulator.join();
+}
+
+long long Pipeline::getTotalWait()const
+{
+    return bank.getTotalWait();
+}
+
+int Pipeline::getCustomerCount()const
+{
+    return bank.getCustomerCount();
+}
+
+//Pipeline================================================================================================
+
+//InputReader=============================================================================================
+
+bool InputReader::refill()
+{
+    if(mapped||atEnd)
+        return false;
+    size_t rest=length-position;
+    if(rest+BLOCK_SIZE>bufferSize)              //a line longer than the buffer, make room
+    {
+        bufferSize=2*(rest+BLOCK_SIZE);
+        char *newBuffer=new char[bufferSize];
+        memcpy(newBuffer,data+position,rest);
+        delete[] buffer;
+        buffer=newBuffer;
+    }
+    else
+        memmove(buffer,data+position,rest);
+    size_t got=fread(buffer+rest,1,BLOCK_SIZE,stdin);
+    if(got==0)
+        atEnd=true;
+    data=buffer;
+    length=rest+got;
+    position=0;
+    return got>0;
+}
+
+InputReader::InputReader():data(""),length(0),position(0),buffer(nullptr),bufferSize(0),mapped(false),atEnd(false){}
+
+InputReader::~InputReader()
+{
+    if(mapped)
+        munmap(const_cast<char*>(data),length);
+    delete[] buffer;
+}
+
+bool InputReader::open(const char *path)
+{
+    int fd=::open(path,O_RDONLY);
+    if(fd<0)
+        return false;
+    struct stat info;
+    if(fstat(fd,&info)<0)
+    {
+        close(fd);
+        return false;
+    }
+    mapped=true;
+    length=info.st_size;
+    position=0;
+    data="";
+    if(length>0)
+    {
+        void *address=mmap(nullptr,length,PROT_READ,MAP_PRIVATE,fd,0);
+        if(address==MAP_FAILED)
+        {
+            close(fd);
+            mapped=false;
+            return false;
+        }
+        madvise(address,length,MADV_SEQUENTIAL);
+        data=static_cast<const char*>(address);
+    }
+    close(fd);
+    return true;
+}
+
+bool InputReader::readLine(string_view &line)
+{
+    while(true)
+    {
+        const char *begin=data+position;
+        const char *newline=static_cast<const char*>(memchr(begin,'\n',length-position));
+        if(newline!=nullptr)
+        {
+            line=string_view(begin,newline-begin);
+            position=newline-data+1;
+            break;
+        }
+        if(!refill())                           //last line without a newline
+        {
+            if(position==length)
+                return false;
+            line=string_view(data+position,length-position);
+            position=length;
+            break;
+        }
+    }
+    if(!line.empty()&&line.back()=='\r')
+        line.remove_suffix(1);
+    return true;
+}
+
+//InputReader=============================================================================================
+
+#ifdef PERF_STATS
+//PerfStats===============================================================================================
+
+PerfStats::PerfStats()
+{
+    memset(phaseNs,0,sizeof(phaseNs));
+    memset(phaseCalls,0,sizeof(phaseCalls));
+    memset(counters,0,sizeof(counters));
+    memset(latency,0,sizeof(latency));
+}
+
+void PerfStats::addTime(PerfPhase phase,long long ns)
+{
+    phaseNs[phase]+=ns;
+    phaseCalls[phase]++;
+    if(phase==PERF_RECORD)
+    {
+        int bucket=0;
+        while(bucket<BUCKETS-1&&(ns>>(bucket+1))>0)
+            bucket++;
+        latency[bucket]++;
+    }
+}
+
+void PerfStats::count(PerfCounter counter,long long amount)
+{
+    counters[counter]+=amount;
+}
+
+void PerfStats::keepMax(PerfCounter counter,long long value)
+{
+    if(value>counters[counter])
+        counters[counter]=value;
+}
+
+bool PerfStats::writeReport(const char *path)const
+{
+    static const char *PHASE_NAMES[PERF_PHASES]={"record","parse","drain","route","depart","change","emit","output"};
+    static const char *COUNTER_NAMES[PERF_COUNTERS]={"events_popped","heap_sift_steps","queue_trim_steps","line_allocations","max_line_length","times_decoded"};
+    FILE *out=fopen(path,"w");
+    if(out==nullptr)
+        return false;
+    fprintf(out,"{\n  \"phases\": {");                              //phases nest: record holds the rest
+    for(int i=0;i<PERF_PHASES;i++)
+        fprintf(out,"%s\n    \"%s\": {\"calls\": %lld, \"ns\": %lld}",i?",":"",PHASE_NAMES[i],phaseCalls[i],phaseNs[i]);
+    fprintf(out,"\n  },\n  \"counters\": {");
+    for(int i=0;i<PERF_COUNTERS;i++)
+        fprintf(out,"%s\n    \"%s\": %lld",i?",":"",COUNTER_NAMES[i],counters[i]);
+    fprintf(out,"\n  },\n  \"record_latency_ns_log2\": [");             //entry i counts records that took [2^i,2^(i+1)) ns
+    int used=BUCKETS;
+    while(used>1&&latency[used-1]==0)
+        used--;
+    for(int i=0;i<used;i++)
+        fprintf(out,"%s%lld",i?", ":"",latency[i]);
+    fprintf(out,"]\n}\n");
+    return fclose(out)==0;
+}
+
+void PerfStats::merge(const PerfStats &other)
+{
+    for(int i=0;i<PERF_PHASES;i++)
+    {
+        phaseNs[i]+=other.phaseNs[i];
+        phaseCalls[i]+=other.phaseCalls[i];
+    }
+    for(int i=0;i<PERF_COUNTERS;i++)
+        counters[i]=(i==PERF_MAX_LINE)?max(counters[i],other.counters[i]):counters[i]+other.counters[i];   //the only keepMax counter
+    for(int i=0;i<BUCKETS;i++)
+        latency[i]+=other.latency[i];
+}
+
+PerfStats::ThreadStats::~ThreadStats()
+{
+    lock_guard<mutex> guard(finishedLock());
+    finished().merge(stats);
+}
+
+mutex& PerfStats::finishedLock()
+{
+    static mutex lock;
+    return lock;
+}
+
+PerfStats& PerfStats::finished()
+{
+    static PerfStats stats;
+    return stats;
+}
+
+PerfStats& PerfStats::global()
+{
+    static thread_local ThreadStats local;
+    return local.stats;
+}
+
+PerfStats PerfStats::total()
+{
+    PerfStats sum;
+    {
+        lock_guard<mutex> guard(finishedLock());
+        sum.merge(finished());
+    }
+    sum.merge(global());
+    return sum;
+}
+
+PerfTimer::PerfTimer(PerfPhase phase):phase(phase),start(chrono::steady_clock::now()){}
+
+PerfTimer::~PerfTimer()
+{
+    PerfStats::global().addTime(phase,chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now()-start).count());
+}
+
+//PerfStats===============================================================================================
+#endif
+
+int main(int argc,char *argv[])
+{
+    int reserve_hint=0;                                         //expected number of customers
+    bool pipelined=false;                                       //parse, simulate and write on three threads
+    const char *input_path=nullptr;                             //trace file to map, stdin if not given
+    bool alloc_stats=false;                                     //report line allocations on stderr
+    const char *perf_report_path=nullptr;                       //JSON from the PERF_STATS counters
+    for(int i=1;i<argc;i++)
+    {
+        if(!strcmp(argv[i],"--bench-heap"))                     //time the heaps instead of simulating
+        {
+            bench_heap(i+1<argc?atoi(argv[i+1]):1000000);
+            return 0;
+        }
+        else if(!strcmp(argv[i],"--bench-events"))              //heap against timing wheel as the event list
+        {
+            bench_events(i+1<argc?atoi(argv[i+1]):1000000);
+            return 0;
+        }
+        else if(!strcmp(argv[i],"--reserve")&&i+1<argc)
+            reserve_hint=atoi(argv[++i]);
+        else if(!strcmp(argv[i],"--alloc-stats"))
+            alloc_stats=true;
+        else if(!strcmp(argv[i],"--pipeline"))
+            pipelined=true;
+        else if(!strcmp(argv[i],"--input")&&i+1<argc)
+            input_path=argv[++i];
+        else if(!strcmp(argv[i],"--perf-report")&&i+1<argc)
+            perf_report_path=argv[++i];
+        else if(!strcmp(argv[i],"--gen"))                       //write a synthetic trace to stdout
+        {
+            TraceConfig config;
+            for(i++;i<argc;i++)
+                if(!config.set(argv[i]))
+                {
+                    cerr<<"unknown trace setting "<<argv[i]<<endl;
+                    return 1;
+                }
+            generate_trace(config,stdout);
+            return 0;
+        }
+        else if(!strcmp(argv[i],"--diff"))                      //reference engine against this one
+            return diff_engines(argc-i-1,argv+i+1);
+        else if(!strcmp(argv[i],"--batch"))                     //one trace against a grid of (m,n)
+            return run_batch(argc-i-1,argv+i+1);
+        else if(!strcmp(argv[i],"--optimize"))                  //fewest counters that keep the wait under a target
+            return run_optimize(argc-i-1,argv+i+1);
+        else if(!strcmp(argv[i],"--branches"))                  //many banks in one trace, one shard each
+            return run_branches(argc-i-1,argv+i+1);
+        else if(!strcmp(argv[i],"--convert")&&i+2<argc)         //text trace to the binary format
+        {
+            InputReader reader;
+            FILE *out=fopen(argv[i+2],"wb");
+            if((strcmp(argv[i+1],"-")&&!reader.open(argv[i+1]))||out==nullptr)
+            {
+                cerr<<"can not open "<<(out==nullptr?argv[i+2]:argv[i+1])<<endl;
+                if(out!=nullptr)
+                    fclose(out);
+                return 1;
+            }
+            int status=convert_trace(reader,out);
+            if(fclose(out)!=0)
+                status=1;
+            return status;
+        }
+        else if(!strcmp(argv[i],"--replay")&&i+1<argc)          //simulate a binary trace
+            return replay_trace(argv[i+1],stdout,reserve_hint);
+        else if(!strcmp(argv[i],"--bench"))                     //end to end runs on generated traces
+        {
+            bench_suite(i+1<argc?atoi(argv[i+1]):1000000);
+            return 0;
+        }
+    }
+
+    InputReader reader;
+    if(input_path!=nullptr&&!reader.open(input_path))
+    {
+        cerr<<"can not open "<<input_path<<endl;
+        return 1;
+    }
+    int status=pipelined?simulate_pipelined(reader,stdout,reserve_hint):simulate(reader,stdout,reserve_hint,alloc_stats);
+    if(perf_report_path!=nullptr)
+    {
+#ifdef PERF_STATS
+        if(!PerfStats::total().writeReport(perf_report_path))
+            cerr<<"can not write "<<perf_report_path<<endl;
+#else
+        cerr<<"--perf-report needs a build with -DPERF_STATS"<<endl;
+#endif
+    }
+    return status;
+}
+
+int simulate(InputReader &reader,FILE *out,int reserve_hint,bool alloc_stats)     //the optimized engine
+{
+    int n=0,m=0;
+
+    string_view statement;
+    if(reader.readLine(statement))                              //m n, and optionally the expected customers
+    {
+        m=parse_int(next_token(statement));
+        n=parse_int(next_token(statement));
+        int expected=parse_int(next_token(statement));
+        if(expected>reserve_hint)
+            reserve_hint=expected;
+    }
+
+    OutputWriter writer(out);
+    BankSimulator bank;
+    bank.configure(m,n);
+    bank.reserve(reserve_hint);
+    bank.setCompletionCallback(write_completion,&writer);      //served customers, printed in end/arrive order
+
+    Record record;
+
+    while(reader.readLine(statement))
+    {
+        PERF_SCOPE(PERF_RECORD);
+        if(statement.empty())
+            break;
+        if(!parse_record(statement,record))
+            continue;
+        bank.feed(record);
+    }
+    bank.finish();                                              //the remaining events, print all customer information
+
+    double avg=(double)bank.getTotalWait()/bank.getCustomerCount();
+    writer.writeDouble(round(avg));
+    writer.write('\n');
+    writer.flush();
+
+    long long allocations=bank.getAllocationCount();
+    PERF_COUNT(PERF_LINE_ALLOCATIONS,allocations);
+    if(alloc_stats)
+        cerr<<"lines: "<<allocations<<" heap allocations for "<<bank.getCustomerCount()<<" customers"<<endl;
+    return 0;
+}
+
+int simulate_pipelined(InputReader &reader,FILE *out,int reserve_hint)     //simulate() with parsing and printing on their own threads
+{
+    int n=0,m=0;
+
+    string_view statement;
+    if(reader.readLine(statement))                              //m n, and optionally the expected customers
+    {
+        m=parse_int(next_token(statement));
+        n=parse_int(next_token(statement));
+        int expected=parse_int(next_token(statement));
+        if(expected>reserve_hint)
+            reserve_hint=expected;
+    }
+
+    OutputWriter writer(out);
+    Pipeline pipeline(&reader,m,n,reserve_hint);
+    pipeline.run(writer);
+
+    double avg=(double)pipeline.getTotalWait()/pipeline.getCustomerCount();
+    writer.writeDouble(round(avg));
+    writer.write('\n');
+    writer.flush();
+    return 0;
+}
+
+void write_completion(void *context,string_view name,int start_time,int end_time)   //one output line of simulate()
+{
+    OutputWriter *writer=(OutputWriter*)context;
+    writer->write(name.data(),name.size());
+    writer->write(' ');
+    writer->writeTime(start_time);
+    writer->write(' ');
+    writer->writeTime(end_time);
+    writer->write('\n');
+}
+
+int time_to_second(const char *t)                                   //change HH:MM:SS into second
+{
+    PERF_COUNT(PERF_TIMES_DECODED,1);                               //a clock read would cost more than the decode, its time is part of parse
+    int h=(t[0]-'0')*10+(t[1]-'0');
+    int m=(t[3]-'0')*10+(t[4]-'0');
+    int s=(t[6]-'0')*10+(t[7]-'0');
+    return 3600*h+60*m+s;
+}
+
+bool is_time(string_view token)                                     //HH:MM:SS, the only form time_to_second reads
+{
+    if(token.size()!=8||token[2]!=':'||token[5]!=':')
+        return false;
+    for(int i=0;i<8;i++)
+        if(i!=2&&i!=5&&(token[i]<'0'||token[i]>'9'))
+            return false;
+    return true;
+}
+
+int parse_int(string_view token)                                    //decimal number, 0 if there is none
+{
+    int value=0;
+    bool negative=false;
+    size_t i=0;
+    if(i<token.size()&&(token[i]=='-'||token[i]=='+'))
+        negative=(token[i++]=='-');
+    for(;i<token.size()&&token[i]>='0'&&token[i]<='9';i++)
+        value=value*10+(token[i]-'0');
+    return negative?-value:value;
+}
+
+string_view next_token(string_view &rest)                           //cut the next space separated word off rest
+{
+    size_t begin=0;
+    while(begin<rest.size()&&(rest[begin]==' '||rest[begin]=='\t'))
+        begin++;
+    size_t end=begin;
+    while(end<rest.size()&&rest[end]!=' '&&rest[end]!='\t')
+        end++;
+    string_view token=rest.substr(begin,end-begin);
+    rest.remove_prefix(end);
+    return token;
+}
+
+string_view next_line(string_view &rest)                            //cut the next line off rest, without the newline
+{
+    size_t end=rest.find('\n');
+    if(end==string_view::npos)
+        end=rest.size();
+    string_view line=rest.substr(0,end);
+    rest.remove_prefix(end<rest.size()?end+1:end);
+    return line;
+}
+
+bool parse_record(string_view line,Record &record)                 //split one input line, nothing is copied
+{
+    PERF_SCOPE(PERF_PARSE);
+    string_view token=next_token(line);
+    if(!is_time(token))                                             //not a record, skip the line
+        return false;
+    record.time=time_to_second(token.data());
+    token=next_token(line);
+    if(token.empty())
+        return false;
+    if(token=="A")
+        record.code='A';
+    else if(token=="D")
+        record.code='D';
+    else
+        record.code='C';
+    record.name=next_token(line);
+    record.name_id=-1;
+    record.business=false;
+    record.value=0;
+    if(record.code=='A')
+    {
+        record.business=(next_token(line)=="B");
+        record.value=parse_int(next_token(line));
+        if(record.value<0)                                          //nobody leaves the counter before reaching it
+            return false;
+    }
+    else if(record.code=='C')
+        record.value=parse_int(next_token(line));
+    return true;
+}
+
+static const char TWO_DIGITS[]=
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+int format_time(int t,char *out)                                    //write HH:MM:SS, return its length
+{
+    int h=t/3600,length=0;
+    t=t%3600;
+    if(h<100)
+    {
+        memcpy(out,TWO_DIGITS+2*h,2);
+        length=2;
+    }
+    else                                                            //past four days, more digits
+        length=snprintf(out,16,"%d",h);
+    out[length]=':';
+    memcpy(out+length+1,TWO_DIGITS+2*(t/60),2);
+    out[length+3]=':';
+    memcpy(out+length+4,TWO_DIGITS+2*(t%60),2);
+    return length+6;
+}
+
+string second_to_time(int t)                                        //change second to time string
+{
+    char time_tag[24];
+    return string(time_tag,format_time(t,time_tag));
+}
+
+template <typename PQ,typename T>
+double bench_heap_run(const T items[],int count)                    //ns per add+remove pair
+{
+    PQ *heapPtr=new PQ;                                             //fixed storage is too big for the stack
+    PQ &heap=*heapPtr;
+    chrono::steady_clock::time_point start=chrono::steady_clock::now();
+    for(int i=0;i<count/2;i++)                                      //fill half, then hold, then drain
+        heap.add(items[i]);
+    for(int i=count/2;i<count;i++)
+    {
+        heap.remove();
+        heap.add(items[i]);
+    }
+    while(!heap.isEmpty())
+        heap.remove();
+    chrono::steady_clock::time_point stop=chrono::steady_clock::now();
+    delete heapPtr;
+    return chrono::duration<double,nano>(stop-start).count()/count;
+}
+
+void bench_heap(int count)                                          //compare arities on both payloads
+{
+    Event *events=new Event[count];
+    Customer *customers=new Customer[count];
+    unsigned int seed=12345;
+    for(int i=0;i<count;i++)
+    {
+        seed=seed*1103515245+12345;
+        int t=(seed>>8)%86400;
+        events[i]=Event(i,t,t+(seed>>4)%600,false,0);
+        customers[i]=Customer(i,t,(seed>>4)%600,false);
+        customers[i].end_time=t+(seed>>4)%600;
+    }
+    const int FIXED_CAPACITY=1<<17;
+    cout<<"payload  arity  ns/op ("<<count<<" items)"<<endl;
+    cout<<"Event    2      "<<bench_heap_run<Heap_PriorityQueue<Event,EventBefore,2>>(events,count)<<endl;
+    cout<<"Event    4      "<<bench_heap_run<Heap_PriorityQueue<Event,EventBefore,4>>(events,count)<<endl;
+    cout<<"Event    8      "<<bench_heap_run<Heap_PriorityQueue<Event,EventBefore,8>>(events,count)<<endl;
+    if(count/2<=FIXED_CAPACITY)                                     //the bench holds count/2 items at most
+        cout<<"Event    4 fix  "<<bench_heap_run<Heap_PriorityQueue<Event,EventBefore,4,FixedStorage<FIXED_CAPACITY>::Of>>(events,count)<<endl;
+    cout<<"Customer 2      "<<bench_heap_run<Heap_PriorityQueue<Customer,CustomerBefore,2>>(customers,count)<<endl;
+    cout<<"Customer 4      "<<bench_heap_run<Heap_PriorityQueue<Customer,CustomerBefore,4>>(customers,count)<<endl;
+    cout<<"Customer 8      "<<bench_heap_run<Heap_PriorityQueue<Customer,CustomerBefore,8>>(customers,count)<<endl;
+    delete[] events;
+    delete[] customers;
+}
+
+template <typename PQ>
+double bench_events_run(const int delays[],int count)               //ns per event: pop the first, schedule a later one
+{
+    PQ *listPtr=new PQ;
+    PQ &list=*listPtr;
+    chrono::steady_clock::time_point start=chrono::steady_clock::now();
+    for(int i=0;i<count/2;i++)
+        list.emplace(i,0,delays[i],false,0);
+    for(int i=count/2;i<count;i++)
+    {
+        Event ev=list.pop();
+        list.emplace(i,ev.left_time,ev.left_time+delays[i],false,0);
+    }
+    while(!list.isEmpty())
+        list.remove();
+    chrono::steady_clock::time_point stop=chrono::steady_clock::now();
+    delete listPtr;
+    return chrono::duration<double,nano>(stop-start).count()/count;
+}
+
+void bench_events(int count)                                        //dense: leaves within minutes, sparse: within days
+{
+    int *dense=new int[count];
+    int *sparse=new int[count];
+    unsigned int seed=12345;
+    for(int i=0;i<count;i++)
+    {
+        seed=seed*1103515245+12345;
+        dense[i]=(seed>>8)%600;
+        sparse[i]=(seed>>8)%(86400*7);
+    }
+    cout<<"trace   list   ns/op ("<<count<<" events)"<<endl;
+    cout<<"dense   heap   "<<bench_events_run<Heap_PriorityQueue<Event,EventBefore,4>>(dense,count)<<endl;
+    cout<<"dense   wheel  "<<bench_events_run<TimingWheel<Event,EventTime>>(dense,count)<<endl;
+    cout<<"sparse  heap   "<<bench_events_run<Heap_PriorityQueue<Event,EventBefore,4>>(sparse,count)<<endl;
+    cout<<"sparse  wheel  "<<bench_events_run<TimingWheel<Event,EventTime>>(sparse,count)<<endl;
+    delete[] dense;
+    delete[] sparse;
+}
+
+//TraceConfig=============================================================================================
+
+TraceConfig::TraceConfig():records(100000),m(40),n(10),seed(1),rate(0.15),service(300),dist('e'),business(0.2),depart(0.02),change(0.02),noise(0),reuse(0),pairs(0),ties(0),start(8*3600){}
+
+bool TraceConfig::set(const char *arg)
+{
+    const char *value=strchr(arg,'=');
+    if(value==nullptr)
+        return false;
+    string_view key(arg,value-arg);
+    value++;
+    if(key=="records")
+        records=atoi(value);
+    else if(key=="m")
+        m=atoi(value);
+    else if(key=="n")
+        n=atoi(value);
+    else if(key=="seed")
+        seed=strtoul(value,nullptr,10);
+    else if(key=="rate")
+        rate=atof(value);
+    else if(key=="service")
+        service=atof(value);
+    else if(key=="dist")
+        dist=value[0];
+    else if(key=="business")
+        business=atof(value);
+    else if(key=="depart")
+        depart=atof(value);
+    else if(key=="change")
+        change=atof(value);
+    else if(key=="noise")
+        noise=atof(value);
+    else if(key=="reuse")
+        reuse=atof(value);
+    else if(key=="pairs")
+        pairs=atof(value);
+    else if(key=="ties")
+        ties=atof(value);
+    else if(key=="start")
+        start=atoi(value);
+    else
+        return false;
+    return true;
+}
+
+//TraceConfig=============================================================================================
+
+int generate_trace(const TraceConfig &config,FILE *out)             //replays the lines while writing, so D and C name someone waiting
+{
+    const int LAST_SECOND=99*3600+59*60+59;                         //HH:MM:SS holds two hour digits
+    mt19937 random(config.seed);
+    uniform_real_distribution<double> unit(0.0,1.0);
+    exponential_distribution<double> gap(config.rate>0?config.rate:1.0);
+    exponential_distribution<double> service(config.service>0?1.0/config.service:1.0);
+    int lineCount=config.m+config.n;                                //business lines first, as in the input
+    vector<deque<int>> lines(lineCount);                            //customer ids, the front one is at the counter
+    TournamentTree business_shortest(config.n),normal_shortest(config.m);
+    int waitingCount=0;                                             //customers in a line but not at a counter yet
+    vector<int> need;
+    vector<char> business;
+    vector<int> label;//number in the name c<label> of each customer, shared when names are reused
+    vector<char> shared;//label -> some other customer took it too
+    Heap_PriorityQueue<Event,EventBefore,4> events;
+    OutputWriter writer(out);
+    writer.writeInt(config.m);
+    writer.write(' ');
+    writer.writeInt(config.n);                                      //no expected count, so the original program reads it too
+    writer.write('\n');
+    double clock=config.start;
+    int written=0;
+    while(written<config.records)
+    {
+        if(written==0||unit(random)>=config.ties)
+            clock+=gap(random);
+        int t=(int)clock;
+        if(t>LAST_SECOND)
+            break;
+        while(!events.isEmpty()&&events.peek().left_time<=t)
+        {
+            Event ev=events.pop();
+            deque<int> &line=lines[ev.counter];
+            line.pop_front();
+            (ev.business?business_shortest:normal_shortest).update(ev.business?ev.counter:ev.counter-config.n,line.size());
+            if(!line.empty())
+            {
+                waitingCount--;
+                events.emplace(line.front(),ev.left_time,ev.left_time+need[line.front()],ev.business,ev.counter);
+            }
+        }
+        double x=unit(random);
+        if(x<config.depart+config.change)
+        {
+            int c=-1,from=-1,position=-1,to=-1;
+            if(!need.empty()&&unit(random)<config.noise)                //anyone, anywhere: served, at a counter, a bad line
+            {
+                c=(int)(unit(random)*need.size())%need.size();
+                to=(int)(unit(random)*(lineCount+2))-1;
+                for(int k=0;k<lineCount&&from<0;k++)
+                    for(int j=0;j<(int)lines[k].size();j++)
+                        if(lines[k][j]==c)
                         {
-                            found=true;
-                            total_time+=arrive_time-business_line[i].peekFront().arrive_time;
-                            customer_num++;
+                            from=k;
+                            position=j;
+                            break;
                         }
-                        business_line[i].dequeue();
-                    }
+            }
+            else if(waitingCount>0)
+            {
+                int pick=(int)(unit(random)*waitingCount);
+                if(pick>=waitingCount)
+                    pick=waitingCount-1;
+                for(from=0;;from++)
+                {
+                    int waitingHere=lines[from].size()>1?lines[from].size()-1:0;
+                    if(pick<waitingHere)
+                        break;
+                    pick-=waitingHere;
+                }
+                position=pick+1;                                    //the one at the counter stays
+                c=lines[from][position];
+                if(x>=config.depart)
+                {
+                    vector<int> targets;                            //lines the simulator would move c to
+                    for(int k=0;k<lineCount;k++)
+                        if(k!=from&&lines[k].size()<lines[from].size()&&(k>=config.n||business[c]))
+                            targets.push_back(k);
+                    if(targets.empty())
+                        c=-1;                                       //nowhere to go, make it an arrival
+                    else
+                        to=targets[(int)(unit(random)*targets.size())%targets.size()];
+                }
+            }
+            if(c>=0)
+            {
+                bool depart=x<config.depart;
+                writer.writeTime(t);
+                writer.write(depart?" D c":" C c",4);
+                writer.writeInt(label[c]);                          //with reused names the simulator may pick others of that name
+                if(!depart)
+                {
+                    writer.write(' ');
+                    writer.writeInt(to);
+                }
+                writer.write('\n');
+                written++;
+                if(!depart&&(to<0||to>=lineCount))                 //a bad line, the simulator ignores it
+                    continue;
+                bool isShared=shared[label[c]];
+                if(isShared)                                        //the simulator stops at the first line holding the name
+                {
+                    from=-1;
+                    for(int k=0;k<lineCount&&from<0;k++)
+                        for(int j=0;j<(int)lines[k].size();j++)
+                            if(label[lines[k][j]]==label[c])
+                            {
+                                from=k;
+                                break;
+                            }
                 }
-                else if(i>=n&&!found)                               //normal counter
+                if(from<0)
+                    continue;
+                deque<int> &source=lines[from];
+                for(int j=isShared?1:max(position,1);j<(int)source.size();)    //the one at the counter stays, the others of that name go
                 {
-                    int size=normal_line[i-n].get_size();
-                    for(int j=0;j<size;j++)
+                    int d=source[j];
+                    if(label[d]!=label[c]||(!depart&&(source.size()<=lines[to].size()||(to<config.n&&!business[d]))))
+                        j++;
+                    else
                     {
-                        if(normal_line[i-n].peekFront().name.compare(name))
-                            normal_line[i-n].enqueue(normal_line[i-n].peekFront());
-                        else if(normal_line[i-n].peekFront().name.compare(name)&&j==0)
-                        {
-                            found=true;
-                            normal_line[i-n].enqueue(normal_line[i-n].peekFront());
-                        }
-                        else
+                        source.erase(source.begin()+j);
+                        waitingCount--;
+                        if(!depart)
                         {
-                            found=true;
-                            total_time+=arrive_time-normal_line[i-n].peekFront().arrive_time;
-                            customer_num++;
+                            lines[to].push_back(d);
+                            (to<config.n?business_shortest:normal_shortest).update(to<config.n?to:to-config.n,lines[to].size());
+                            if(lines[to].size()==1)
+                                events.emplace(d,t,t+need[d],to<config.n,to);
+                            else
+                                waitingCount++;
                         }
-                        normal_line[i-n].dequeue();
                     }
+                    if(!isShared)                                   //c is the only one, no need to walk the line
+                        break;
                 }
+                (from<config.n?business_shortest:normal_shortest).update(from<config.n?from:from-config.n,source.size());
+                continue;
             }
         }
+        bool isBusiness=unit(random)<config.business;
+        int time_need=(int)config.service;
+        if(config.dist=='e')
+            time_need=(int)(service(random)+0.5);
+        else if(config.dist=='u')
+            time_need=(int)(unit(random)*2*config.service+0.5);
+        int c=need.size();
+        need.push_back(time_need);
+        business.push_back(isBusiness);
+        label.push_back(c);
+        shared.push_back(false);
+        if(c>0&&unit(random)<config.reuse)                          //one of the last 64, likely still around
+        {
+            label[c]=label[c-1-(int)(unit(random)*min(c,64))%min(c,64)];
+            shared[label[c]]=true;
+        }
+        int best=normal_shortest.getWinner();                       //same routing as the simulator
+        int best_business=business_shortest.getWinner();
+        if(best>=0)
+            best+=config.n;
+        if(isBusiness&&best_business>=0&&(best<0||business_shortest.getValue(best_business)<=normal_shortest.getValue(best-config.n)))
+            best=best_business;
+        if(best>=0&&config.pairs>0&&!lines[best].empty()&&unit(random)<config.pairs)   //two of one name in one line
+        {
+            label[c]=label[lines[best].back()];
+            shared[label[c]]=true;
+        }
+        if(best>=0)
+        {
+            lines[best].push_back(c);
+            (best<config.n?business_shortest:normal_shortest).update(best<config.n?best:best-config.n,lines[best].size());
+            if(lines[best].size()==1)
+                events.emplace(c,t,t+time_need,best<config.n,best);
+            else
+                waitingCount++;
+        }
+        writer.writeTime(t);
+        writer.write(" A c",4);
+        writer.writeInt(label[c]);
+        writer.write(isBusiness?" B ":" N ",3);
+        writer.writeInt(time_need);
+        writer.write('\n');
+        written++;
+    }
+    writer.flush();
+    return written;
+}
+
+template <typename Q>
+double bench_queue_run(int count)                                   //ns per enqueue+dequeue pair
+{
+    Q queue;
+    chrono::steady_clock::time_point start=chrono::steady_clock::now();
+    for(int i=0;i<count/2;i++)
+        queue.enqueue(i);
+    for(int i=count/2;i<count;i++)
+    {
+        queue.dequeue();
+        queue.enqueue(i);
+    }
+    while(!queue.isEmpty())
+        queue.dequeue();
+    chrono::steady_clock::time_point stop=chrono::steady_clock::now();
+    return chrono::duration<double,nano>(stop-start).count()/count;
+}
+
+bool bench_run(const char *path,double &ms,long &peak_kb)           //simulate in a child, so the peak RSS is the run's own
+{
+    chrono::steady_clock::time_point start=chrono::steady_clock::now();
+    pid_t pid=fork();
+    if(pid<0)
+        return false;
+    if(pid==0)
+    {
+        int null=::open("/dev/null",O_WRONLY);
+        if(null>=0)
+            dup2(null,STDOUT_FILENO);
+        execl("/proc/self/exe","bank","--input",path,(char*)nullptr);
+        _exit(127);
+    }
+    int status=0;
+    struct rusage usage;
+    if(wait4(pid,&status,0,&usage)<0)
+        return false;
+    ms=chrono::duration<double,milli>(chrono::steady_clock::now()-start).count();
+    peak_kb=usage.ru_maxrss;
+    return WIFEXITED(status)&&WEXITSTATUS(status)==0;
+}
+
+void bench_suite(int records)                                       //the baseline every change is measured against
+{
+    TraceConfig configs[3];
+    const char *labels[3]={"steady","rush","far"};
+    double load[3]={0.9,1.2,0.5};                                   //arrivals over what the counters can serve
+    configs[1].service=120;                                         //rush: lines grow, people give up or move
+    configs[1].depart=0.1;
+    configs[1].change=0.1;
+    configs[2].service=3600;                                        //far: long visits, events far apart
+    configs[2].dist='u';
+    cout<<"trace   records  ms        records/s  peak_rss_kb"<<endl;
+    for(int i=0;i<3;i++)
+    {
+        configs[i].records=records;
+        configs[i].rate=records/(80.0*3600);                        //fit the day into the 99 hours HH:MM:SS can hold
+        int counters=(int)ceil(configs[i].rate*configs[i].service/load[i]);
+        configs[i].n=counters/5;
+        configs[i].m=counters-configs[i].n;
+        char path[]="/tmp/bank_traceXXXXXX";
+        int fd=mkstemp(path);
+        FILE *file=(fd>=0)?fdopen(fd,"w"):nullptr;
+        if(file==nullptr)
+        {
+            cerr<<"can not create a trace file"<<endl;
+            return;
+        }
+        int written=generate_trace(configs[i],file);
+        fclose(file);
+        double ms=0;
+        long peak_kb=0;
+        if(bench_run(path,ms,peak_kb))
+            printf("%-7s %-8d %-9.1f %-10.0f %ld\n",labels[i],written,ms,written/(ms/1000),peak_kb);
+        else
+            cerr<<labels[i]<<": simulation failed"<<endl;
+        unlink(path);
+    }
+    cout<<endl<<"container          ns/op   ops/s"<<endl;
+    int *delays=new int[records];
+    unsigned int seed=12345;
+    for(int i=0;i<records;i++)
+    {
+        seed=seed*1103515245+12345;
+        delays[i]=(seed>>8)%600;
+    }
+    double ns[4];
+    ns[0]=bench_events_run<Heap_PriorityQueue<Event,EventBefore,4>>(delays,records);
+    ns[1]=bench_events_run<TimingWheel<Event,EventTime>>(delays,records);
+    ns[2]=bench_queue_run<LinkedQueue<int>>(records);
+    ns[3]=bench_queue_run<ArrayQueue<int>>(records);
+    const char *names[4]={"ArrayMaxHeap","TimingWheel","LinkedQueue","ArrayQueue"};
+    for(int i=0;i<4;i++)
+        printf("%-18s %-7.1f %.0f\n",names[i],ns[i],1e9/ns[i]);
+    delete[] delays;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF,&usage);
+    cout<<"containers peak_rss_kb "<<usage.ru_maxrss<<endl;
+}
 
-        else                                            //change line event
+//ReferenceEngine=========================================================================================
+
+int simulate_reference(InputReader &reader,FILE *out)               //the original algorithm, kept simple to check simulate() against
+{                                                                   //lines are scanned and rotated; D and C keep the original rules
+    int n=0,m=0,customer_num=0;
+    long long total_time=0;
+    string_view statement;
+    if(reader.readLine(statement))
+    {
+        m=parse_int(next_token(statement));
+        n=parse_int(next_token(statement));
+    }
+    LinkedQueue<Customer> *normal_line=new LinkedQueue<Customer>[m];
+    LinkedQueue<Customer> *business_line=new LinkedQueue<Customer>[n];
+    Heap_PriorityQueue<Event,EventBefore> event_list;               //Event::customer holds the name id here
+    vector<Customer> served;
+    NameTable names;
+    Record record;
+    while(reader.readLine(statement))
+    {
+        if(statement.empty())
+            break;
+        if(!parse_record(statement,record))
+            continue;
+        int arrive_time=record.time;
+        while(!event_list.isEmpty()&&arrive_time>=event_list.peek().left_time)    //handle event list
+        {
+            Event ev=event_list.pop();
+            int i=ev.counter;                                       //numbered like the C record, a name may be at several fronts
+            LinkedQueue<Customer> &line=(i<n)?business_line[i]:normal_line[i-n];
+            assert(!line.isEmpty()&&line.peekFront().name==ev.customer);
+            Customer temp=line.peekFront();
+            temp.wait+=ev.start_time-temp.arrive_time;
+            total_time+=temp.wait;
+            line.dequeue();
+            customer_num++;
+            temp.start_time=ev.start_time;
+            temp.end_time=ev.left_time;
+            served.push_back(temp);
+            if(!line.isEmpty())
+                event_list.emplace(line.peekFront().name,ev.left_time,ev.left_time+line.peekFront().time_need,i<n,i);
+        }
+        if(record.code=='A')                                        //arrival event
+        {
+            Customer cus(names.intern(record.name),arrive_time,record.value,record.business);
+            int short_lengh=INT_MAX,short_id=-1;
+            for(int i=0;i<n+m;i++)                                  //check every counter
+            {
+                if(!cus.business&&i<n)
+                    continue;
+                int num=(i<n)?business_line[i].get_size():normal_line[i-n].get_size();
+                if(num<short_lengh)
+                    short_lengh=num,short_id=i;
+            }
+            if(short_id<0)
+                continue;
+            LinkedQueue<Customer> &line=(short_id<n)?business_line[short_id]:normal_line[short_id-n];
+            if(line.isEmpty())
+            {
+                event_list.emplace(cus.name,arrive_time,arrive_time+cus.time_need,short_id<n,short_id);
+                cus.start_time=arrive_time;
+            }
+            line.enqueue(cus);
+            continue;
+        }
+        int name=names.find(record.name);                           //D and C: rotate every line once looking for name
+        int target=record.value;
+        if(name<0||(record.code=='C'&&(target<0||target>=n+m)))
+            continue;
+        LinkedQueue<Customer> *to=(record.code=='D')?nullptr:(target<n)?&business_line[target]:&normal_line[target-n];
+        for(int i=0;i<m+n;i++)
         {
-            name=strtok(NULL," ");
+            LinkedQueue<Customer> &line=(i<n)?business_line[i]:normal_line[i-n];
+            int size=line.get_size();
             bool found=false;
-            int line;
-            cut=strtok(NULL," ");
-            line=stoi(cut);
-            for(int i=0;i<m+n;i++)
+            for(int j=0;j<size;j++)                                 //exactly size steps, whoever stays keeps the order
             {
-                if(i<n&&!found)
+                Customer temp=line.peekFront();
+                bool stay=temp.name!=name||j==0;                    //the one at the counter stays
+                found=found||temp.name==name;
+                if(!stay&&to!=nullptr)                              //only to a shorter line, business lines for business only
+                    stay=line.get_size()<=to->get_size()||(target<n&&!temp.business);
+                line.dequeue();
+                if(stay)
+                    line.enqueue(temp);
+                else if(to==nullptr)
                 {
-                    int size=business_line[i].get_size();
-                    for(int j=0;j<size;j++)
-                    {
-                        if(business_line[i].peekFront().name.compare(name))
-                            business_line[i].enqueue(business_line[i].peekFront());
-                        else if(!business_line[i].peekFront().name.compare(name)&&j==0)
-                        {
-                            found=true;
-                            business_line[i].enqueue(business_line[i].peekFront());
-                        }
-                        else
-                        {
-                            found=true;
-                            int x=business_line[i].get_size(),y;
-                            if(line>=n)
-                                y=normal_line[line-n].get_size();
-                            else
-                                y=business_line[i].get_size();
-                            if(x<=y)
-                                continue;
-                            Customer temp=business_line[i].peekFront();
-                            temp.wait+=arrive_time-business_line[i].peekFront().arrive_time;
-                            temp.arrive_time=arrive_time;
-                            Event new_ev(temp.name,arrive_time,arrive_time+temp.time_need);
-                            if(line>=n)
-                            {
-                                if(normal_line[line-n].get_size()==0)
-                                {
-                                    event_list.add(new_ev);
-                                    normal_counter[line-n]=true;
-                                }
-                                normal_line[line-n].enqueue(temp);
-                            }
-                            else
-                            {
-                                if(business_line[line].get_size()==0)
-                                {
-                                    event_list.add(new_ev);
-                                    business_counter[line]=true;
-                                }
-                                business_line[line].enqueue(temp);
-                            }
-                        }
-                        business_line[i].dequeue();
-                    }
+                    total_time+=arrive_time-temp.arrive_time;
+                    customer_num++;
                 }
-                else if(i>=n&&!found)
+                else
                 {
-                    int size=normal_line[i-n].get_size();
-                    for(int j=0;j<size;j++)
-                    {
-                        if(normal_line[i-n].peekFront().name.compare(name))
-                            normal_line[i-n].enqueue(normal_line[i-n].peekFront());
-                        else if(normal_line[i-n].peekFront().name.compare(name)&&j==0)
-                        {
-                            found=true;
-                            normal_line[i-n].enqueue(normal_line[i-n].peekFront());
-                        }
-                        else
-                        {
-                            found=true;
-                            int x=normal_line[i-n].get_size(),y;
-                            if(line>=n)
-                                y=normal_line[line-n].get_size();
-                            else
-                                y=business_line[i].get_size();
-                            if(x<=y)
-                                continue;
-                            if(!normal_line[i-n].peekFront().business&&line<n)
-                                continue;
-                            Customer temp=normal_line[i-n].peekFront();
-                            temp.wait+=arrive_time-normal_line[i-n].peekFront().arrive_time;
-                            temp.arrive_time=arrive_time;
-                            Event new_ev(temp.name,arrive_time,arrive_time+temp.time_need);
-                            if(line>=n)
-                            {
-                                if(normal_line[line-n].get_size()==0)
-                                {
-                                    event_list.add(new_ev);
-                                    normal_counter[line-n]=true;
-                                }
-                                normal_line[line-n].enqueue(temp);
-                            }
-                            else
-                            {
-                                if(business_line[line].get_size()==0)
-                                {
-                                    event_list.add(new_ev);
-                                    business_counter[line]=true;
-                                }
-                                business_line[line].enqueue(temp);
-                            }
-                        }
-                        normal_line[i-n].dequeue();
-                    }
+                    temp.wait+=arrive_time-temp.arrive_time;
+                    temp.arrive_time=arrive_time;
+                    if(to->isEmpty())
+                        event_list.emplace(temp.name,arrive_time,arrive_time+temp.time_need,target<n,target);
+                    to->enqueue(temp);
                 }
             }
+            if(found)                                               //the first line holding the name ends the scan, even at its counter
+                break;
         }
     }
-    if(!event_list.isEmpty())                                       //the remaining event
+    while(!event_list.isEmpty())                                    //the remaining event
+    {
+        Event ev=event_list.pop();
+        int i=ev.counter;
+        LinkedQueue<Customer> &line=(i<n)?business_line[i]:normal_line[i-n];
+        assert(!line.isEmpty()&&line.peekFront().name==ev.customer);
+        Customer temp=line.peekFront();
+        temp.wait+=ev.start_time-temp.arrive_time;
+        total_time+=temp.wait;
+        line.dequeue();
+        customer_num++;
+        temp.start_time=ev.start_time;
+        temp.end_time=ev.left_time;
+        served.push_back(temp);
+        if(!line.isEmpty())
+            event_list.emplace(line.peekFront().name,ev.left_time,ev.left_time+line.peekFront().time_need,i<n,i);
+    }
+    stable_sort(served.begin(),served.end(),CustomerBefore());      //print all customer information
+    OutputWriter writer(out);
+    for(size_t i=0;i<served.size();i++)
+    {
+        string text=string(names.getName(served[i].name))+" "+second_to_time(served[i].start_time)+" "+second_to_time(served[i].end_time)+"\n";
+        writer.write(text);
+    }
+    double avg=(double)total_time/customer_num;
+    writer.writeDouble(round(avg));
+    writer.write('\n');
+    writer.flush();
+    delete[] normal_line;
+    delete[] business_line;
+    return 0;
+}
+
+//ReferenceEngine=========================================================================================
+
+bool diff_trace(const char *path,const char *label,const char *expected,double &fast_ms,double &reference_ms)   //false if the outputs differ, from each other or from expected
+{
+    char *outputs[2]={nullptr,nullptr};
+    size_t lengths[2]={0,0};
+    double ms[2]={0,0};
+    for(int engine=0;engine<2;engine++)
+    {
+        InputReader reader;
+        if(!reader.open(path))
+        {
+            cerr<<"can not open "<<path<<endl;
+            return false;
+        }
+        FILE *out=open_memstream(&outputs[engine],&lengths[engine]);
+        chrono::steady_clock::time_point start=chrono::steady_clock::now();
+        if(engine==0)
+            simulate(reader,out,0,false);
+        else
+            simulate_reference(reader,out);
+        ms[engine]=chrono::duration<double,milli>(chrono::steady_clock::now()-start).count();
+        fclose(out);
+    }
+    fast_ms=ms[0];
+    reference_ms=ms[1];
+    string_view fast(outputs[0],lengths[0]),reference(outputs[1],lengths[1]);
+    bool same=(fast==reference);
+    const char *fastName="fast:     ";
+    if(same&&expected!=nullptr&&fast!=expected)                     //both moved away from the known answer
+    {
+        same=false;
+        fast=expected;
+        fastName="expected: ";
+    }
+    int lineNumber=1;
+    if(!same)                                                       //show the first line that differs
+    {
+        string_view fastLine,referenceLine;
+        while(true)
+        {
+            fastLine=next_line(fast);
+            referenceLine=next_line(reference);
+            if(fastLine!=referenceLine||(fast.empty()&&reference.empty()))
+                break;
+            lineNumber++;
+        }
+        printf("%-16s DIFF at output line %d\n  reference: %.*s\n  %s%.*s\n",label,lineNumber,(int)referenceLine.size(),referenceLine.data(),fastName,(int)fastLine.size(),fastLine.data());
+    }
+    else
+        printf("%-16s same   %-9.1f %-9.1f %.1fx\n",label,reference_ms,fast_ms,reference_ms/(fast_ms>0?fast_ms:1e-3));
+    free(outputs[0]);
+    free(outputs[1]);
+    return same;
+}
+
+int diff_engines(int argc,char *argv[])                             //trace files, or key=value settings for generated ones
+{
+    TraceConfig base;
+    base.records=20000;
+    vector<const char*> files;
+    for(int i=0;i<argc;i++)
+    {
+        if(strchr(argv[i],'=')==nullptr)
+            files.push_back(argv[i]);
+        else if(!base.set(argv[i]))
+        {
+            cerr<<"unknown trace setting "<<argv[i]<<endl;
+            return 1;
+        }
+    }
+    printf("trace            result ref_ms    fast_ms   speedup\n");
+    int differ=0;
+    double fastTotal=0,referenceTotal=0,fast_ms,reference_ms;
+    for(size_t i=0;i<files.size();i++)
+    {
+        if(!diff_trace(files[i],files[i],nullptr,fast_ms,reference_ms))
+            differ++;
+        fastTotal+=fast_ms;
+        referenceTotal+=reference_ms;
+    }
+    for(int i=0;files.empty()&&i<8;i++)                              //no files: a spread of generated days
+    {
+        TraceConfig config=base;
+        config.seed=base.seed+i;
+        static const int COUNTERS[8]={1,2,3,5,8,13,21,34};
+        static const double LOAD[4]={0.7,0.95,1.1,1.3};              //past 1 the lines keep growing
+        config.n=COUNTERS[i]/3;
+        config.m=COUNTERS[i]-config.n;
+        config.rate=LOAD[i%4]*COUNTERS[i]/config.service;
+        config.depart=(i%2)?0.1:base.depart;
+        config.change=(i%2)?0.1:base.change;
+        config.noise=(i%2)?0.3:base.noise;
+        config.reuse=(i%4>=2)?0.3:base.reuse;                       //names shared by customers in line together
+        config.ties=(i%4>=2)?0.3:base.ties;
+        config.pairs=(i%2)?0.2:base.pairs;                          //namesakes behind each other or behind the counter
+        char path[]="/tmp/bank_diffXXXXXX";
+        int fd=mkstemp(path);
+        FILE *file=(fd>=0)?fdopen(fd,"w"):nullptr;
+        if(file==nullptr)
+        {
+            cerr<<"can not create a trace file"<<endl;
+            return 1;
+        }
+        generate_trace(config,file);
+        fclose(file);
+        char label[32];
+        snprintf(label,sizeof(label),"gen seed=%u",config.seed);
+        if(!diff_trace(path,label,nullptr,fast_ms,reference_ms))
+            differ++;
+        fastTotal+=fast_ms;
+        referenceTotal+=reference_ms;
+        unlink(path);
+    }
+    static const char *const CASES[][3]={                           //small days with the original program's answer
+        {"D namesakes","1 0\n08:00:00 A a N 100\n08:00:01 A x N 5\n08:00:02 A x N 7\n08:00:03 D x\n",
+            "a 08:00:00 08:01:40\n1\n"},                            //every x behind the counter leaves
+        {"D x at counter","1 1\n08:00:00 A x B 100\n08:00:01 A y N 100\n08:00:02 A x N 50\n08:00:03 D x\n",
+            "x 08:00:00 08:01:40\ny 08:00:01 08:01:41\nx 08:01:41 08:02:31\n33\n"},    //the scan stops at the first line holding x
+    };
+    for(int i=0;files.empty()&&i<(int)(sizeof(CASES)/sizeof(CASES[0]));i++)
+    {
+        char path[]="/tmp/bank_diffXXXXXX";
+        int fd=mkstemp(path);
+        FILE *file=(fd>=0)?fdopen(fd,"w"):nullptr;
+        if(file==nullptr)
+        {
+            cerr<<"can not create a trace file"<<endl;
+            return 1;
+        }
+        fputs(CASES[i][1],file);
+        fclose(file);
+        if(!diff_trace(path,CASES[i][0],CASES[i][2],fast_ms,reference_ms))
+            differ++;
+        unlink(path);
+    }
+    printf("total speedup %.1fx, %d trace(s) differ\n",referenceTotal/(fastTotal>0?fastTotal:1e-3),differ);
+    NodePool<Customer> &pool=NodePool<Customer>::shared();              //the reference engine's lines
+    printf("reference node pool: %lld nodes handed out, at most %d at once, %lld heap allocations\n",pool.getAcquireCount(),pool.getPeakCount(),pool.getAllocationCount());
+    return differ?1:0;
+}
+
+void batch_task(void *context,int worker,int task)                  //simulate one (m,n) of the batch
+{
+    BatchJob *job=(BatchJob*)context;
+    BatchResult &result=job->results[task];
+    BankSimulator &bank=job->simulators[worker];
+    bank.configure(result.m,result.n);
+    const vector<Record> &records=job->trace->records;
+    for(size_t i=0;i<records.size();i++)
+        bank.feed(records[i]);
+    bank.finish();
+    result.customers=bank.getCustomerCount();
+    result.total_wait=bank.getTotalWait();
+    result.makespan=bank.getMakespan();
+    int lines=result.m+result.n;
+    result.load_min=lines>0?1:0;
+    result.load_avg=0;
+    result.load_max=0;
+    for(int i=0;i<lines;i++)
+    {
+        double load=result.makespan>0?(double)bank.getBusyTime(i)/result.makespan:0;
+        result.load_min=min(result.load_min,load);
+        result.load_max=max(result.load_max,load);
+        result.load_avg+=load/lines;
+    }
+}
+
+bool parse_range(const char *text,int &low,int &high)               //LO-HI or a single number
+{
+    char *end;
+    low=strtol(text,&end,10);
+    high=low;
+    if(*end=='-')
+        high=strtol(end+1,&end,10);
+    return end!=text&&*end=='\0'&&low>=0&&low<=high;
+}
+
+int run_batch(int argc,char *argv[])                                //the trace once, every (m,n) of the grid on all cores
+{
+    const char *path=nullptr;
+    int m_low=1,m_high=-1,n_low=0,n_high=-1;                        //the grid defaults to 1..m by 0..n of the header
+    int threads=thread::hardware_concurrency();
+    for(int i=0;i<argc;i++)
+    {
+        bool ok=true;
+        if(!strncmp(argv[i],"m=",2))
+            ok=parse_range(argv[i]+2,m_low,m_high);
+        else if(!strncmp(argv[i],"n=",2))
+            ok=parse_range(argv[i]+2,n_low,n_high);
+        else if(!strncmp(argv[i],"threads=",8))
+            threads=atoi(argv[i]+8);
+        else if(strchr(argv[i],'=')==nullptr)
+            path=argv[i];
+        else
+            ok=false;
+        if(!ok)
+        {
+            cerr<<"unknown batch setting "<<argv[i]<<endl;
+            return 1;
+        }
+    }
+
+    chrono::steady_clock::time_point start=chrono::steady_clock::now();
+    ParsedTrace trace;
+    {
+        InputReader reader;
+        if(path!=nullptr&&!reader.open(path))
+        {
+            cerr<<"can not open "<<path<<endl;
+            return 1;
+        }
+        if(!trace.load(reader))
+        {
+            cerr<<"empty trace"<<endl;
+            return 1;
+        }
+    }
+    if(m_high<0)
+        m_high=max(trace.m,m_low);
+    if(n_high<0)
+        n_high=max(trace.n,n_low);
+    double parse_ms=chrono::duration<double,milli>(chrono::steady_clock::now()-start).count();
+
+    int configs=(m_high-m_low+1)*(n_high-n_low+1);
+    BatchResult *results=new BatchResult[configs];
+    for(int i=0;i<configs;i++)
+    {
+        results[i].m=m_low+i/(n_high-n_low+1);
+        results[i].n=n_low+i%(n_high-n_low+1);
+    }
+    TaskPool pool(min(threads,configs));
+    BatchJob job;
+    job.trace=&trace;
+    job.simulators=new BankSimulator[pool.getWorkerCount()];
+    job.results=results;
+    start=chrono::steady_clock::now();
+    pool.run(configs,batch_task,&job);
+    double run_ms=chrono::duration<double,milli>(chrono::steady_clock::now()-start).count();
+
+    printf("   m    n  customers  avg_wait  makespan  load_min  load_avg  load_max\n");
+    for(int i=0;i<configs;i++)
+    {
+        BatchResult &r=results[i];
+        printf("%4d %4d %10d %9.0f %9d %8.1f%% %8.1f%% %8.1f%%\n",r.m,r.n,r.customers,r.customers>0?round((double)r.total_wait/r.customers):0.0,
+            r.makespan,100*r.load_min,100*r.load_avg,100*r.load_max);
+    }
+    printf("%zu records parsed once in %.1f ms, %d configurations on %d threads in %.1f ms\n",trace.records.size(),parse_ms,configs,pool.getWorkerCount(),run_ms);
+    delete[] job.simulators;
+    delete[] results;
+    return 0;
+}
+
+int sla_run(BankSimulator &bank,const ParsedTrace &trace,int m,int n,long long limit,long long &total_wait)  //1 meets, 0 misses, -1 gave up early
+{
+    bank.configure(m,n);
+    const vector<Record> &records=trace.records;
+    for(size_t i=0;i<records.size();i++)
+    {
+        bank.feed(records[i]);
+        if(2*bank.getTotalWait()>=limit)                                //waits only add up, it can not get back under
+            return -1;
+    }
+    bank.finish();
+    total_wait=bank.getTotalWait();
+    return 2*total_wait<limit?1:0;
+}
+
+void optimize_task(void *context,int worker,int task)                  //bisect m for one n, assuming more counters never wait longer
+{
+    OptimizeJob *job=(OptimizeJob*)context;
+    BankSimulator &bank=job->simulators[worker];
+    int low=job->m_low,high=job->m_high;
+    bool highMeets=false;
+    long long highWait=-1,total_wait=0;
+    while(true)
     {
-        while(!event_list.isEmpty())
         {
-            Event ev=event_list.peek();
-            for(int i=0;i<m+n;i++)
+            lock_guard<mutex> guard(job->lock);
+            for(int i=0;i<(int)job->best.size();i++)                    //fewer business counters need at least as many m, more need at most as many
             {
-                if(i<n)                                             //business counter
+                int m=job->best[i];
+                if(m<0)
+                    continue;
+                if(i<task&&m!=OptimizeJob::NONE&&(m<high||(m==high&&!highMeets)))
                 {
-                    if(business_counter[i]&&!business_line[i].peekFront().name.compare(ev.name))
-                    {
-                        Customer temp=business_line[i].peekFront();
-                        temp.wait+=ev.start_time-temp.arrive_time;
-                        total_time+=temp.wait;
-                        business_line[i].dequeue();
-                        customer_num++;
-                        temp.start_time=ev.start_time;
-                        temp.end_time=ev.left_time;
-                        customer_list.add(temp);
-                        if(!business_line[i].isEmpty())
-                        {
-                            Event new_ev(business_line[i].peekFront().name,ev.left_time,ev.left_time+business_line[i].peekFront().time_need);
-                            event_list.remove();
-                            event_list.add(new_ev);
-                        }
-                        else
-                        {
-                            business_counter[i]=false;
-                            event_list.remove();
-                        }
-                        break;
-                    }
+                    high=m;                                             //known to meet, no need to run it
+                    highMeets=true;
+                    highWait=-1;
                 }
-                else                                                //normal counter
+                else if(i>task)
                 {
-                    if(normal_counter[i-n]&&!normal_line[i-n].peekFront().name.compare(ev.name))
+                    if(m==OptimizeJob::NONE)
                     {
-                        Customer temp=normal_line[i-n].peekFront();
-                        temp.wait+=ev.start_time-temp.arrive_time;
-                        total_time+=temp.wait;
-                        normal_line[i-n].dequeue();
-                        customer_num++;
-                        temp.start_time=ev.start_time;
-                        temp.end_time=ev.left_time;
-                        customer_list.add(temp);
-                        if(!normal_line[i-n].isEmpty())
-                        {
-                            Event new_ev(normal_line[i-n].peekFront().name,ev.left_time,ev.left_time+normal_line[i-n].peekFront().time_need);
-                            event_list.remove();
-                            event_list.add(new_ev);
-                        }
-                        else
-                        {
-                            normal_counter[i-n]=false;
-                            event_list.remove();
-                        }
-                        break;
+                        job->best[task]=OptimizeJob::NONE;
+                        return;
                     }
+                    low=max(low,m);
                 }
             }
-            if(event_list.isEmpty())
-                break;
+            if(highMeets&&low>=high)
+            {
+                job->best[task]=high;
+                job->best_wait[task]=highWait;
+                return;
+            }
+        }
+        int m=highMeets?(low+high)/2:high;
+        int result=sla_run(bank,*job->trace,m,job->n_low+task,job->limit,total_wait);
+        {
+            lock_guard<mutex> guard(job->lock);
+            job->evaluations++;
+            if(result<0)
+                job->aborted++;
+        }
+        if(result>0)
+        {
+            high=m;
+            highMeets=true;
+            highWait=total_wait;
+        }
+        else if(!highMeets)                                             //even the most counters miss
+        {
+            lock_guard<mutex> guard(job->lock);
+            job->best[task]=OptimizeJob::NONE;
+            return;
         }
+        else
+            low=m+1;
     }
+}
 
-    while(!customer_list.isEmpty())                                 //print all customer information
+int run_optimize(int argc,char *argv[])                                 //smallest m for every n that keeps round(avg) under sla
+{
+    const char *path=nullptr;
+    int m_low=1,m_high=-1,n_low=0,n_high=-1,sla=-1;                     //m defaults to 1..2m of the header, n to 0..n
+    int threads=thread::hardware_concurrency();
+    for(int i=0;i<argc;i++)
     {
-        Customer temp=customer_list.peek();
-        cout<<temp.name<<" "<<second_to_time(temp.start_time)<<" "<<second_to_time(temp.end_time)<<endl;
-        customer_list.remove();
+        bool ok=true;
+        if(!strncmp(argv[i],"m=",2))
+            ok=parse_range(argv[i]+2,m_low,m_high)&&m_low>0;
+        else if(!strncmp(argv[i],"n=",2))
+            ok=parse_range(argv[i]+2,n_low,n_high);
+        else if(!strncmp(argv[i],"sla=",4))
+            sla=atoi(argv[i]+4);
+        else if(!strncmp(argv[i],"threads=",8))
+            threads=atoi(argv[i]+8);
+        else if(strchr(argv[i],'=')==nullptr)
+            path=argv[i];
+        else
+            ok=false;
+        if(!ok)
+        {
+            cerr<<"unknown optimize setting "<<argv[i]<<endl;
+            return 1;
+        }
+    }
+    if(sla<=0)
+    {
+        cerr<<"--optimize needs sla=SECONDS"<<endl;
+        return 1;
     }
 
-    double avg=(double)total_time/customer_num;
-    cout<<round(avg)<<endl;
-    
+    chrono::steady_clock::time_point start=chrono::steady_clock::now();
+    ParsedTrace trace;
+    {
+        InputReader reader;
+        if(path!=nullptr&&!reader.open(path))
+        {
+            cerr<<"can not open "<<path<<endl;
+            return 1;
+        }
+        if(!trace.load(reader))
+        {
+            cerr<<"empty trace"<<endl;
+            return 1;
+        }
+    }
+    if(m_high<0)
+        m_high=max(2*trace.m,m_low);
+    if(n_high<0)
+        n_high=max(trace.n,n_low);
+    long long arrivals=0;                                               //with m>0 every arrival is counted once
+    for(size_t i=0;i<trace.records.size();i++)
+        if(trace.records[i].code=='A')
+            arrivals++;
+
+    int count=n_high-n_low+1;
+    OptimizeJob job;
+    job.trace=&trace;
+    job.m_low=m_low;
+    job.m_high=m_high;
+    job.n_low=n_low;
+    job.limit=(2LL*sla-1)*arrivals;                                     //round(avg)<sla means avg<sla-0.5
+    job.best.assign(count,-1);
+    job.best_wait.assign(count,-1);
+    job.evaluations=0;
+    job.aborted=0;
+    TaskPool pool(min(threads,count));
+    job.simulators=new BankSimulator[pool.getWorkerCount()];
+    pool.run(count,optimize_task,&job);
+    double ms=chrono::duration<double,milli>(chrono::steady_clock::now()-start).count();
+
+    printf("   n  min_m  avg_wait  counters  pareto\n");
+    int frontier=OptimizeJob::NONE;                                     //smallest m of the n before
+    for(int i=0;i<count;i++)
+    {
+        int m=job.best[i];
+        if(m==OptimizeJob::NONE)
+        {
+            printf("%4d      -         -         -\n",n_low+i);
+            continue;
+        }
+        bool pareto=m<frontier;                                         //no smaller n gets by with as few m
+        if(pareto)
+            frontier=m;
+        if(job.best_wait[i]>=0)
+            printf("%4d %6d %9.0f %9d  %s\n",n_low+i,m,round((double)job.best_wait[i]/arrivals),m+n_low+i,pareto?"*":"");
+        else
+            printf("%4d %6d         - %9d  %s\n",n_low+i,m,m+n_low+i,pareto?"*":"");
+    }
+    printf("sla %d s, m in %d..%d, %lld simulations (%lld stopped early) on %d threads in %.1f ms\n",sla,m_low,m_high,job.evaluations,job.aborted,pool.getWorkerCount(),ms);
+    delete[] job.simulators;
     return 0;
 }
 
-int time_to_second(string t)                                        //change time string into second
+int load_branches(InputReader &reader,Branch *&branches)              //K, K lines of "id m n", then records led by their branch id; -1 if malformed
 {
-    string tt=t;
-    int h,m,s;
-    h=stoi(t.substr(0,2));
-    m=stoi(t.substr(3,2));
-    s=stoi(t.substr(6,2));
-    return 3600*h+60*m+s;
+    string_view statement;
+    if(!reader.readLine(statement))
+        return -1;
+    int count=parse_int(next_token(statement));
+    if(count<=0)
+        return -1;
+    branches=new Branch[count];
+    HashTable<int,int> index;                                          //branch id -> position in branches
+    for(int i=0;i<count;i++)
+    {
+        if(!reader.readLine(statement))
+            return -1;
+        branches[i].id=parse_int(next_token(statement));
+        branches[i].trace.m=parse_int(next_token(statement));
+        branches[i].trace.n=parse_int(next_token(statement));
+        if(index.find(branches[i].id)!=nullptr)
+            return -1;
+        index.add(branches[i].id,i);
+    }
+    Record record;
+    while(reader.readLine(statement))
+    {
+        if(statement.empty())
+            break;
+        int *branch=index.find(parse_int(next_token(statement)));
+        if(branch!=nullptr&&parse_record(statement,record))            //records of unknown branches are skipped
+            branches[*branch].trace.add(record);
+    }
+    return count;
 }
 
-string second_to_time(int t)                                        //change second to time string
+void write_branch_completion(void *context,string_view name,int start_time,int end_time)  //an output line of simulate() led by the branch id
+{
+    Branch *branch=(Branch*)context;
+    branch->writer->writeInt(branch->id);
+    branch->writer->write(' ');
+    write_completion(branch->writer,name,start_time,end_time);
+}
+
+void branch_task(void *context,int worker,int task)                    //simulate one branch into its own buffer
 {
-    string time_tag="";
-    int h=t/3600;
-    if(h<10)
+    BranchJob *job=(BranchJob*)context;
+    Branch &branch=job->branches[task];
+    BankSimulator &bank=job->simulators[worker];
+    FILE *out=open_memstream(&branch.output,&branch.outputSize);
     {
-        time_tag.append("0");
-        time_tag.append(to_string(h));
-        time_tag.append(":");
+        OutputWriter writer(out);
+        branch.writer=&writer;
+        bank.configure(branch.trace.m,branch.trace.n);
+        bank.setCompletionCallback(write_branch_completion,&branch);
+        const vector<Record> &records=branch.trace.records;
+        for(size_t i=0;i<records.size();i++)
+            bank.feed(records[i]);
+        bank.finish();
+        writer.writeInt(branch.id);
+        writer.write(' ');
+        writer.writeDouble(round((double)bank.getTotalWait()/bank.getCustomerCount()));
+        writer.write('\n');
+        branch.writer=nullptr;
     }
-    else
+    fclose(out);
+    bank.setCompletionCallback(nullptr,nullptr);
+}
+
+int run_branches(int argc,char *argv[])                                //every branch of one trace on all cores, printed in header order
+{
+    const char *path=nullptr;
+    int threads=thread::hardware_concurrency();
+    for(int i=0;i<argc;i++)
     {
-        time_tag.append(to_string(h));
-        time_tag.append(":");
+        if(!strncmp(argv[i],"threads=",8))
+            threads=atoi(argv[i]+8);
+        else if(strchr(argv[i],'=')==nullptr)
+            path=argv[i];
+        else
+        {
+            cerr<<"unknown branches setting "<<argv[i]<<endl;
+            return 1;
+        }
     }
-    t=t%3600;
-    int m=t/60;
-    int s=t%60;
-    if(m<10)
+
+    Branch *branches=nullptr;
+    int count;
+    {
+        InputReader reader;
+        if(path!=nullptr&&!reader.open(path))
+        {
+            cerr<<"can not open "<<path<<endl;
+            return 1;
+        }
+        count=load_branches(reader,branches);
+    }
+    if(count<0)
     {
-        time_tag.append("0");
-        time_tag.append(to_string(m));
-        time_tag.append(":");
+        cerr<<"bad branch header"<<endl;
+        delete[] branches;
+        return 1;
     }
-    else
+
+    TaskPool pool(min(threads,count));                                  //a busy branch is one task, the others get stolen around it
+    BranchJob job;
+    job.branches=branches;
+    job.simulators=new BankSimulator[pool.getWorkerCount()];
+    pool.run(count,branch_task,&job);
+    for(int i=0;i<count;i++)                                            //the merge does not depend on which thread ran what
+        fwrite(branches[i].output,1,branches[i].outputSize,stdout);
+    fflush(stdout);
+    delete[] job.simulators;
+    delete[] branches;
+    return 0;
+}
+
+int convert_trace(InputReader &reader,FILE *out)                       //text trace to header, name table and fixed 16 byte records
+{
+    BinaryHeader header;
+    memcpy(header.magic,"BKTR",4);
+    header.version=BinaryHeader::VERSION;
+    header.m=header.n=0;
+    string_view statement;
+    if(reader.readLine(statement))
     {
-        time_tag.append(to_string(m));
-        time_tag.append(":");
+        header.m=parse_int(next_token(statement));
+        header.n=parse_int(next_token(statement));
     }
-    if(s<10)
+    NameTable names;
+    vector<BinaryRecord> records;
+    Record record;
+    while(reader.readLine(statement))
     {
-        time_tag.append("0");
-        time_tag.append(to_string(s));
+        if(statement.empty())
+            break;
+        if(!parse_record(statement,record)||record.time<0)
+            continue;
+        BinaryRecord binary;
+        binary.time=record.time;
+        binary.code=record.code;
+        binary.business=record.business;
+        binary.reserved=0;
+        binary.name=names.intern(record.name);
+        binary.value=record.value;
+        records.push_back(binary);
     }
-    else
-        time_tag.append(to_string(s));
-    return time_tag;
+    vector<uint32_t> nameEnds(names.getSize());
+    uint64_t nameBytes=0;
+    for(int i=0;i<names.getSize();i++)
+    {
+        nameBytes+=names.getName(i).size();
+        nameEnds[i]=nameBytes;
+    }
+    if(nameBytes>UINT32_MAX)
+    {
+        cerr<<"names too long for the binary format"<<endl;
+        return 1;
+    }
+    header.recordCount=records.size();
+    header.nameCount=names.getSize();
+    header.nameBytes=nameBytes;
+    fwrite(&header,sizeof(header),1,out);
+    fwrite(nameEnds.data(),sizeof(uint32_t),nameEnds.size(),out);
+    for(int i=0;i<names.getSize();i++)
+        fwrite(names.getName(i).data(),1,names.getName(i).size(),out);
+    static const char PADDING[16]={0};
+    size_t used=sizeof(header)+sizeof(uint32_t)*nameEnds.size()+nameBytes;
+    fwrite(PADDING,1,(16-used%16)%16,out);
+    fwrite(records.data(),sizeof(BinaryRecord),records.size(),out);
+    return ferror(out)?1:0;
+}
+
+int replay_trace(const char *path,FILE *out,int reserve_hint)          //simulate() on a mapped --convert file, nothing is parsed
+{
+    int fd=open(path,O_RDONLY);
+    struct stat info;
+    if(fd<0||fstat(fd,&info)<0||info.st_size<(off_t)sizeof(BinaryHeader))
+    {
+        cerr<<"can not open "<<path<<endl;
+        if(fd>=0)
+            close(fd);
+        return 1;
+    }
+    size_t length=info.st_size;
+    void *address=mmap(nullptr,length,PROT_READ,MAP_PRIVATE,fd,0);
+    close(fd);
+    if(address==MAP_FAILED)
+    {
+        cerr<<"can not map "<<path<<endl;
+        return 1;
+    }
+    madvise(address,length,MADV_SEQUENTIAL);
+    const char *data=static_cast<const char*>(address);
+    const BinaryHeader *header=reinterpret_cast<const BinaryHeader*>(data);
+    size_t nameTable=sizeof(BinaryHeader);
+    size_t nameText=nameTable+sizeof(uint32_t)*(size_t)header->nameCount;
+    size_t recordStart=(nameText+header->nameBytes+15)/16*16;
+    if(memcmp(header->magic,"BKTR",4)||header->version!=BinaryHeader::VERSION||header->nameBytes>length||recordStart>length||(length-recordStart)/sizeof(BinaryRecord)<header->recordCount)
+    {
+        cerr<<path<<" is not a binary trace"<<endl;
+        munmap(address,length);
+        return 1;
+    }
+    const uint32_t *nameEnds=reinterpret_cast<const uint32_t*>(data+nameTable);
+    vector<string_view> names(header->nameCount);                       //views straight into the mapping
+    uint32_t begin=0;
+    for(uint32_t i=0;i<header->nameCount;i++)
+    {
+        if(nameEnds[i]<begin||nameEnds[i]>header->nameBytes)
+        {
+            cerr<<path<<" has a broken name table"<<endl;
+            munmap(address,length);
+            return 1;
+        }
+        names[i]=string_view(data+nameText+begin,nameEnds[i]-begin);
+        begin=nameEnds[i];
+    }
+
+    OutputWriter writer(out);
+    BankSimulator bank;
+    bank.configure(header->m,header->n);
+    bank.reserve(reserve_hint);
+    bank.setCompletionCallback(write_completion,&writer);
+    const BinaryRecord *records=reinterpret_cast<const BinaryRecord*>(data+recordStart);
+    Record record;
+    for(uint32_t i=0;i<header->recordCount;i++)
+    {
+        if(records[i].name>=header->nameCount||(records[i].code=='A'&&records[i].value<0))
+            continue;
+        record.time=records[i].time;
+        record.code=records[i].code;
+        record.name=names[records[i].name];
+        record.name_id=records[i].name;
+        record.business=records[i].business;
+        record.value=records[i].value;
+        bank.feed(record);
+    }
+    bank.finish();
+
+    double avg=(double)bank.getTotalWait()/bank.getCustomerCount();
+    writer.writeDouble(round(avg));
+    writer.write('\n');
+    writer.flush();
+    munmap(address,length);
+    return 0;
 }